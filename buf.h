@@ -7,6 +7,9 @@ struct buf {
   struct buf *prev; // LRU cache list
   struct buf *next;
   struct buf *qnext; // disk queue
+  char **pages;      // whole pages to transfer instead of data (iderwpages)
+  int npages;
+  int done;          // pages transferred so far
   uchar data[BSIZE];
 };
 #define B_VALID 0x2  // buffer has been read from disk
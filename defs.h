@@ -2,7 +2,9 @@ struct buf;
 struct context;
 struct file;
 struct inode;
+struct page;
 struct pipe;
+struct pgstat;
 struct proc;
 struct rtcdate;
 struct spinlock;
@@ -52,15 +54,12 @@ struct inode*   nameiparent(char*, char*);
 int             readi(struct inode*, char*, uint, uint);
 void            stati(struct inode*, struct stat*);
 int             writei(struct inode*, char*, uint, uint);
-int		createSwapFile(struct proc* p);
-int		readFromSwapFile(struct proc * p, char* buffer, uint placeOnFile, uint size);
-int		writeToSwapFile(struct proc* p, char* buffer, uint placeOnFile, uint size);
-int		removeSwapFile(struct proc* p);
 
 // ide.c
 void            ideinit(void);
 void            ideintr(void);
 void            iderw(struct buf*);
+void            iderwpages(uint dev, uint sector, char **pages, int n, int write);
 
 // ioapic.c
 void            ioapicenable(int irq, int cpu);
@@ -75,6 +74,14 @@ void            kinit2(void*, void*);
     //added task 3//
 int             num_free(void);
 int             initial_pages_num(void);
+void            kref(uint pa);
+int             krefcount(uint pa);
+void            set_frame_owner(uint pa, struct proc *p, void *vaddr);
+struct proc*    frame_owner(uint i, void **vaddr);
+void            set_frame_merged(uint pa);
+int             frame_merged(uint pa);
+int             kref_merged(uint pa);
+int             merged_savings(void);
 
 // kbd.c
 void            kbdintr(void);
@@ -109,6 +116,25 @@ int             piperead(struct pipe*, char*, int);
 int             pipewrite(struct pipe*, char*, int);
 
 //PAGEBREAK: 16
+// policy.c
+int             enqueue(struct proc*, struct page*);
+struct page*    dequeue(struct proc*);
+void            free_from_queue(struct proc*, struct page*);
+int             page_new_meta(struct proc*, struct page*, void*);
+int             page_in_meta(struct proc*, void*);
+int             page_out_meta(struct proc*, void*);
+void            age_page(struct proc*, struct page*, int);
+void            policy_aged(struct proc*);
+void            policy_fault(struct proc*, void*);
+int             ram_quota(struct proc*);
+void*           select_page_to_back(struct proc*);
+int             seq_passed(struct proc*, struct page*);
+int             find_policy(char *name);
+char*           policy_name(int policy);
+void            policy_set(struct proc *p, int policy);
+void            adaptdump(struct proc *p);
+extern int      pg_policy;
+
 // proc.c
 int             cpuid(void);
 void            exit(void);
@@ -129,6 +155,33 @@ void            wakeup(void*);
 void            yield(void);
 int             is_user_proc(struct proc*);
 void            clean_meta(struct proc *p);
+void            kthread(char *name, void (*fn)(void));
+struct proc*    procslot(int i);
+void            pglock(struct proc *p);
+int             setpolicy(int pid, int policy);
+int             getpgstat(int pid, struct pgstat *st);
+int             pgtrylock(struct proc *p);
+void            pgthaw(struct proc *p);
+void            pgunlock(struct proc *p);
+
+// swap.c
+void            swapinit(void);
+int             swapalloc(void);
+void            swapdup(uint slot);
+void            swapfree(uint slot);
+int             swapavail(void);
+int             swapread(uint slot, char *mem);
+int             swapreadv(uint slot, char **mem, int n);
+int             swapwrite(uint slot, char *mem);
+void            swapdump(void);
+void            swapstat(struct pgstat*);
+
+// trace.c
+void            traceinit(void);
+void            trace(int, struct proc*, uint);
+void            tracestart(void);
+int             tracestop(void);
+int             traceread(char*, int);
 
 // swtch.S
 void            swtch(struct context**, struct context*);
@@ -194,23 +247,41 @@ void            freevm(pde_t*);
 void            inituvm(pde_t*, char*, uint);
 int             loaduvm(pde_t*, char*, struct inode*, uint, uint);
 pde_t*          copyuvm(pde_t*, uint);
+int             cow_fault(struct proc*, uint);
+int             page_fault(struct proc*, uint, int);
+int             prefault(uint, uint);
+void            unhold(struct proc*);
+int             madvise(struct proc*, uint, uint, int);
+int             mlock(struct proc*, uint, uint);
+int             munlock(struct proc*, uint, uint);
+void            kswapdinit(void);
+void            zeroinit(void);
+void            ksminit(void);
+extern int      ra_window;
+extern uint     ra_reads, ra_hits, ra_misses;
+extern uint     zero_outs, zero_ins, clean_outs;
+extern uint     ksm_scanned, ksm_merged;
 void            switchuvm(struct proc*);
 void            switchkvm(void);
 int             copyout(pde_t*, uint, void*, uint);
 void            clearpteu(pde_t *pgdir, char *uva);
     //added in assignment 3//
-int             isPagedOut(struct proc *p,  void* vaddr);
 int             numOfPagedOut(struct proc *p);
 int             numOfPagedIn(struct proc *p);
-int             pageIn(struct proc *p, void* vaddr);
 int             pageOut(struct proc *p,void* vaddr);
 int             add_new_page(struct proc *p, void* vaddr);
-int             copy_parent_swapfile(struct proc *child, struct proc *parent);
+int             add_image_pages(struct proc *p);
+int             copy_paging_meta(struct proc *child, struct proc *parent);
 int             page_out_N(struct proc *p,int N);
 int             safe_page_in(struct proc *p, void* vaddr);
 void            age_process_pages(struct proc* proc);
 void            reset_paging_meta(struct proc* pr);
 int             get_allocated_pages(struct proc *p);
+void            pgstat_sys(struct pgstat *st);
+struct page*    find_page(struct proc*, const void*);
+uint*           pgpte(struct proc*, void*);
+void            ra_account(struct page*, uint, int);
+void            tlb_flush_page(pde_t*, void*);
 int             get_paged_out(struct proc *p);
 
 // number of elements in fixed-size array
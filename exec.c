@@ -2,6 +2,7 @@
 #include "param.h"
 #include "memlayout.h"
 #include "mmu.h"
+#include "pgstat.h"
 #include "proc.h"
 #include "defs.h"
 #include "x86.h"
@@ -14,7 +15,9 @@ exec(char *path, char **argv)
   int i, off;
   uint argc, sz, sp, ustack[3+MAXARG+1];
   struct elfhdr elf;
-  struct inode *ip;
+  struct inode *ip, *image, *oldimage;
+  struct segment seg[NSEG];
+  int nseg;
   struct proghdr ph;
   pde_t *pgdir, *oldpgdir;
   struct proc *curproc = myproc();
@@ -28,6 +31,7 @@ exec(char *path, char **argv)
   }
   ilock(ip);
   pgdir = 0;
+  image = 0;
 
   // Check ELF header
   if(readi(ip, (char*)&elf, 0, sizeof(elf)) != sizeof(elf))
@@ -39,18 +43,12 @@ exec(char *path, char **argv)
     goto bad;
 
 
-    #ifndef NONE
-    //create swap file for this execution.
-    //if it's not init.
-    if(is_user_proc(curproc)){        
-        reset_paging_meta(curproc);
-        if(createSwapFile(curproc) != 0)
-            panic("exec_create swapfile");
-    }
-    #endif
-
-  // Load program into memory.
+  // Record the program segments. Their pages are read from the
+  // file (or zeroed) on first touch, see page_fault.  Segments past
+  // the first NSEG are loaded now, as they have no record to page
+  // in from.
   sz = 0;
+  nseg = 0;
   for(i=0, off=elf.phoff; i<elf.phnum; i++, off+=sizeof(ph)){
     if(readi(ip, (char*)&ph, off, sizeof(ph)) != sizeof(ph))
       goto bad;
@@ -58,16 +56,28 @@ exec(char *path, char **argv)
       continue;
     if(ph.memsz < ph.filesz)
       goto bad;
-    if(ph.vaddr + ph.memsz < ph.vaddr)
-      goto bad;
-    if((sz = allocuvm(pgdir, sz, ph.vaddr + ph.memsz)) == 0)
+    if(ph.vaddr + ph.memsz < ph.vaddr || ph.vaddr + ph.memsz >= KERNBASE)
       goto bad;
     if(ph.vaddr % PGSIZE != 0)
       goto bad;
-    if(loaduvm(pgdir, (char*)ph.vaddr, ip, ph.off, ph.filesz) < 0)
+    if(ph.vaddr < sz)
       goto bad;
+    sz = ph.vaddr + ph.memsz;
+    if(nseg == NSEG){
+      if(allocuvm(pgdir, ph.vaddr, sz) == 0)
+        goto bad;
+      if(loaduvm(pgdir, (char*)ph.vaddr, ip, ph.off, ph.filesz) < 0)
+        goto bad;
+      continue;
+    }
+    seg[nseg].vaddr = ph.vaddr;
+    seg[nseg].memsz = ph.memsz;
+    seg[nseg].off = ph.off;
+    seg[nseg].filesz = ph.filesz;
+    nseg++;
   }
-  iunlockput(ip);
+  image = ip;
+  iunlock(ip);
   end_op();
   ip = 0;
 
@@ -105,13 +115,40 @@ exec(char *path, char **argv)
   safestrcpy(curproc->name, last, sizeof(curproc->name));
 
   // Commit to the user image.
+    #ifndef NONE
+    //no one may page out of the old image once it's gone
+    if(is_user_proc(curproc))
+        pglock(curproc);
+    #endif
   oldpgdir = curproc->pgdir;
+  oldimage = curproc->image;
   curproc->pgdir = pgdir;
   curproc->sz = sz;
+  curproc->image = image;
+  memmove(curproc->seg, seg, sizeof(seg));
+  curproc->nseg = nseg;
   curproc->tf->eip = elf.entry;  // main
   curproc->tf->esp = sp;
+
+    #ifndef NONE
+    //track the pages of the new image, paging out what doesn't fit in RAM.
+    //if it's not init.
+    if(is_user_proc(curproc)){
+        reset_paging_meta(curproc);
+        if(!add_image_pages(curproc)){
+            cprintf("exec: pid %d out of swap space\n",curproc->pid);
+            curproc->killed = 1;
+        }
+        pgunlock(curproc);
+    }
+    #endif
   switchuvm(curproc);
   freevm(oldpgdir);
+  if(oldimage){
+    begin_op();
+    iput(oldimage);
+    end_op();
+  }
   return 0;
 
  bad:
@@ -121,5 +158,10 @@ exec(char *path, char **argv)
     iunlockput(ip);
     end_op();
   }
+  if(image){
+    begin_op();
+    iput(image);
+    end_op();
+  }
   return -1;
 }
@@ -14,6 +14,7 @@
 #include "param.h"
 #include "stat.h"
 #include "mmu.h"
+#include "pgstat.h"
 #include "proc.h"
 #include "spinlock.h"
 #include "sleeplock.h"
@@ -646,139 +647,3 @@ struct inode *
 nameiparent(char *path, char *name) {
     return namex(path, 1, name);
 }
-
-
-#include "fcntl.h"
-
-#define DIGITS 14
-
-char *itoa(int i, char b[]) {
-    char const digit[] = "0123456789";
-    char *p = b;
-    if (i < 0) {
-        *p++ = '-';
-        i *= -1;
-    }
-    int shifter = i;
-    do { //Move to where representation ends
-        ++p;
-        shifter = shifter / 10;
-    } while (shifter);
-    *p = '\0';
-    do { //Move back, inserting digits as u go
-        *--p = digit[i % 10];
-        i = i / 10;
-    } while (i);
-    return b;
-}
-
-//remove swap file of proc p;
-int
-removeSwapFile(struct proc *p) {
-
-    //path of proccess
-    char path[DIGITS];
-    memmove(path, "/.swap", 6);
-    itoa(p->pid, path + 6);
-
-    struct inode *ip, *dp;
-    struct dirent de;
-    char name[DIRSIZ];
-    uint off;
-
-    if (0 == p->swapFile) {
-        return -1;
-    }
-    fileclose(p->swapFile);
-
-    begin_op();
-    if ((dp = nameiparent(path, name)) == 0) {
-        end_op();
-        return -1;
-    }
-
-    ilock(dp);
-
-    // Cannot unlink "." or "..".
-    if (namecmp(name, ".") == 0 || namecmp(name, "..") == 0)
-        goto bad;
-
-    if ((ip = dirlookup(dp, name, &off)) == 0)
-        goto bad;
-    ilock(ip);
-
-    if (ip->nlink < 1)
-        panic("unlink: nlink < 1");
-    if (ip->type == T_DIR && !isdirempty(ip)) {
-        iunlockput(ip);
-        goto bad;
-    }
-
-    memset(&de, 0, sizeof(de));
-    if (writei(dp, (char *) &de, off, sizeof(de)) != sizeof(de))
-        panic("unlink: writei");
-    if (ip->type == T_DIR) {
-        dp->nlink--;
-        iupdate(dp);
-    }
-    iunlockput(dp);
-
-    ip->nlink--;
-    iupdate(ip);
-    iunlockput(ip);
-
-    end_op();
-
-    return 0;
-
-    bad:
-    iunlockput(dp);
-    end_op();
-    return -1;
-
-}
-
-
-//return 0 on success
-int
-createSwapFile(struct proc *p) {
-    char path[DIGITS];
-    memmove(path, "/.swap", 6);
-    itoa(p->pid, path + 6);
-
-    begin_op();
-    struct inode *in = create(path, T_FILE, 0, 0);
-    iunlock(in);
-
-    p->swapFile = filealloc();
-    if (p->swapFile == 0)
-        panic("no slot for files on /store");
-
-    p->swapFile->ip = in;
-    p->swapFile->type = FD_INODE;
-    p->swapFile->off = 0;
-    p->swapFile->readable = O_WRONLY;
-    p->swapFile->writable = O_RDWR;
-    end_op();
-
-    return 0;
-}
-
-
-//return as sys_write (-1 when error)
-int
-writeToSwapFile(struct proc *p, char *buffer, uint placeOnFile, uint size) {
-    p->swapFile->off = placeOnFile;
-    return filewrite(p->swapFile, buffer, size);
-}
-
-//return as sys_read (-1 when error)
-int
-readFromSwapFile(struct proc *p, char *buffer, uint placeOnFile, uint size) {
-    p->swapFile->off = placeOnFile;
-    int toReturn=fileread(p->swapFile, buffer, size);
-    return toReturn;
-};
-
-
-
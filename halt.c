@@ -0,0 +1,12 @@
+// Power the machine off (under QEMU or Bochs).
+
+#include "types.h"
+#include "user.h"
+
+int
+main(void)
+{
+  halt();
+  printf(2, "halt: failed\n");
+  exit();
+}
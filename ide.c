@@ -5,6 +5,7 @@
 #include "param.h"
 #include "memlayout.h"
 #include "mmu.h"
+#include "pgstat.h"
 #include "proc.h"
 #include "x86.h"
 #include "traps.h"
@@ -23,6 +24,9 @@
 #define IDE_CMD_WRITE 0x30
 #define IDE_CMD_RDMUL 0xc4
 #define IDE_CMD_WRMUL 0xc5
+#define IDE_CMD_SETMUL 0xc6
+
+#define SECTOR_PER_PAGE (PGSIZE/SECTOR_SIZE)
 
 // idequeue points to the buf now being read/written to the disk.
 // idequeue->qnext points to the next buf to be processed.
@@ -33,6 +37,7 @@ static struct buf *idequeue;
 
 static int havedisk1;
 static void idestart(struct buf*);
+static void idestartpages(struct buf*);
 
 // Wait for IDE disk to become ready.
 static int
@@ -65,6 +70,13 @@ ideinit(void)
     }
   }
 
+  // Transfer whole pages per interrupt on disk 1 (iderwpages).
+  if(havedisk1){
+    outb(0x1f2, SECTOR_PER_PAGE);
+    outb(0x1f7, IDE_CMD_SETMUL);
+    idewait(0);
+  }
+
   // Switch back to disk 0.
   outb(0x1f6, 0xe0 | (0<<4));
 }
@@ -75,6 +87,10 @@ idestart(struct buf *b)
 {
   if(b == 0)
     panic("idestart");
+  if(b->pages){
+    idestartpages(b);
+    return;
+  }
   if(b->blockno >= FSSIZE)
     panic("incorrect blockno");
   int sector_per_block =  BSIZE/SECTOR_SIZE;
@@ -99,6 +115,35 @@ idestart(struct buf *b)
   }
 }
 
+// Start a page request: one command for all its sectors, which are
+// moved a page per interrupt (multiple mode, see ideinit).
+// Caller must hold idelock.
+static void
+idestartpages(struct buf *b)
+{
+  int sector = b->blockno;
+  int nsect = b->npages * SECTOR_PER_PAGE;
+  int end = SWAPSTART*(BSIZE/SECTOR_SIZE) + NSWAPPAGES*SECTOR_PER_PAGE;
+
+  if(nsect > 255 || sector < FSSIZE*(BSIZE/SECTOR_SIZE) || sector + nsect > end)
+    panic("idestartpages");
+
+  idewait(0);
+  outb(0x3f6, 0);  // generate interrupt
+  outb(0x1f2, nsect);  // number of sectors
+  outb(0x1f3, sector & 0xff);
+  outb(0x1f4, (sector >> 8) & 0xff);
+  outb(0x1f5, (sector >> 16) & 0xff);
+  outb(0x1f6, 0xe0 | ((b->dev&1)<<4) | ((sector>>24)&0x0f));
+  if(b->flags & B_DIRTY){
+    outb(0x1f7, IDE_CMD_WRMUL);
+    idewait(0);
+    outsl(0x1f0, b->pages[0], PGSIZE/4);
+  } else {
+    outb(0x1f7, IDE_CMD_RDMUL);
+  }
+}
+
 // Interrupt handler.
 void
 ideintr(void)
@@ -112,10 +157,24 @@ ideintr(void)
     release(&idelock);
     return;
   }
+
+  // A page request is done after its last page.
+  if(b->pages){
+    if(!(b->flags & B_DIRTY) && idewait(1) >= 0)
+      insl(0x1f0, b->pages[b->done], PGSIZE/4);
+    if(++b->done < b->npages){
+      if(b->flags & B_DIRTY){
+        idewait(0);
+        outsl(0x1f0, b->pages[b->done], PGSIZE/4);
+      }
+      release(&idelock);
+      return;
+    }
+  }
   idequeue = b->qnext;
 
   // Read data if needed.
-  if(!(b->flags & B_DIRTY) && idewait(1) >= 0)
+  if(!b->pages && !(b->flags & B_DIRTY) && idewait(1) >= 0)
     insl(0x1f0, b->data, BSIZE/4);
 
   // Wake process waiting for this buf.
@@ -166,3 +225,37 @@ iderw(struct buf *b)
 
   release(&idelock);
 }
+
+// Read (or, if write, write) n whole pages starting at sector of dev,
+// straight to (from) the pages, with a single disk command.
+// The buffer cache is not involved - used for the swap area.
+void
+iderwpages(uint dev, uint sector, char **pages, int n, int write)
+{
+  struct buf b;  // only the disk queue fields are used
+  struct buf **pp;
+
+  if(dev != 0 && !havedisk1)
+    panic("iderwpages: ide disk 1 not present");
+  b.dev = dev;
+  b.blockno = sector;
+  b.pages = pages;
+  b.npages = n;
+  b.done = 0;
+  b.flags = write ? B_DIRTY : 0;
+
+  acquire(&idelock);
+
+  b.qnext = 0;
+  for(pp=&idequeue; *pp; pp=&(*pp)->qnext)
+    ;
+  *pp = &b;
+
+  if(idequeue == &b)
+    idestart(&b);
+
+  while((b.flags & (B_VALID|B_DIRTY)) != B_VALID)
+    sleep(&b, &idelock);
+
+  release(&idelock);
+}
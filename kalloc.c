@@ -22,8 +22,22 @@ struct {
   struct spinlock lock;
   int use_lock;
   struct run *freelist;
+  int nfree;                    //number of pages on the free list
 } kmem;
 
+// Core map: the owner of every physical frame that holds a tracked user page,
+// and the number of page tables that map the frame (copy-on-write fork).
+// Owners are hints - a frame's owner must confirm it through its page table.
+// A merged frame (same-page merging, the zero frame) is read-only until freed:
+// a write to it is always copied, even by its last user.
+struct frame {
+  struct proc *owner;           //0 if the frame is free or untracked
+  void        *vaddr;           //user virtual address of the frame in owner
+  int         ref;              //references to an allocated frame, kfree drops one
+  int         merged;           //1 if the frame's contents may no longer change
+};
+struct frame coremap[PHYSTOP/PGSIZE];
+
 // Initialization happens in two phases.
 // 1. main() calls kinit1() while still using entrypgdir to place just
 // the pages mapped by entrypgdir on free list.
@@ -63,10 +77,25 @@ kfree(char *v)
 {
 
   struct run *r;
+  struct frame *f;
 
   if((uint)v % PGSIZE || v < end || V2P(v) >= PHYSTOP)
     panic("kfree");
 
+  f = &coremap[V2P(v) >> PGSHIFT];
+  if(kmem.use_lock)             //lock
+    acquire(&kmem.lock);
+  if(f->ref > 1){               //still mapped elsewhere
+    f->ref--;
+    if(kmem.use_lock)
+      release(&kmem.lock);
+    return;
+  }
+  f->ref = 0;
+  f->merged = 0;
+  if(kmem.use_lock)
+    release(&kmem.lock);
+
   // Fill with junk to catch dangling refs.
   memset(v, 1, PGSIZE);         //fill with 1's?
 
@@ -75,6 +104,8 @@ kfree(char *v)
   r = (struct run*)v;           //"cast" into a run*
   r->next = kmem.freelist;      //make it first in the list
   kmem.freelist = r;            //
+  kmem.nfree++;
+  f->owner = 0;
   if(kmem.use_lock)             //unlock
     release(&kmem.lock);
 }
@@ -90,8 +121,11 @@ kalloc(void)
     acquire(&kmem.lock);
   
   r = kmem.freelist;          //take the list of free pages
-  if(r)                       //if not 0
+  if(r){                      //if not 0
     kmem.freelist = r->next;  //"delete" a page. meaning make the list start from the second free page
+    kmem.nfree--;
+    coremap[V2P(r) >> PGSHIFT].ref = 1;
+  }
   if(kmem.use_lock)
     release(&kmem.lock);
 
@@ -101,22 +135,82 @@ kalloc(void)
 //Returns number of free pages in memory
 int
 num_free(void){
-  int counter=0;
-  struct run *r;
+  return kmem.nfree;
+}
 
-  if(kmem.use_lock)           //lock?
+int initial_pages_num(void){
+  return initial_pages;
+}
+
+//add a reference to the allocated frame pa
+void
+kref(uint pa){
+  if(kmem.use_lock)
     acquire(&kmem.lock);
-  r = kmem.freelist;          //take the list of free pages
-  while(r){                       //if not 0
-    counter ++;
-    r = r->next;  
-  }
+  if(coremap[pa >> PGSHIFT].ref < 1)
+    panic("kref");
+  coremap[pa >> PGSHIFT].ref++;
   if(kmem.use_lock)
     release(&kmem.lock);
-  return counter;            //return the page
 }
 
-int initial_pages_num(void){
-  return initial_pages;
+//number of references to frame pa
+int
+krefcount(uint pa){
+  return coremap[pa >> PGSHIFT].ref;
+}
+
+//mark frame pa merged: its contents won't change while it is allocated
+void
+set_frame_merged(uint pa){
+  coremap[pa >> PGSHIFT].merged = 1;
+}
+
+//1 if frame pa is merged
+int
+frame_merged(uint pa){
+  return coremap[pa >> PGSHIFT].merged;
+}
+
+//add a reference to frame pa, only if it is still an allocated merged frame.
+//returns 0 if it is not.
+int
+kref_merged(uint pa){
+  struct frame *f = &coremap[pa >> PGSHIFT];
+  int ok;
+
+  acquire(&kmem.lock);
+  if((ok = f->merged && f->ref > 0))
+    f->ref++;
+  release(&kmem.lock);
+  return ok;
 }
 
+//frames saved by merging: the references to merged frames beyond the first
+int
+merged_savings(void){
+  int i, n = 0;
+
+  for(i = 0; i < PHYSTOP/PGSIZE; i++)
+    if(coremap[i].merged && coremap[i].ref > 1)
+      n += coremap[i].ref - 1;
+  return n;
+}
+
+//record the user page that frame pa holds
+void
+set_frame_owner(uint pa, struct proc *p, void *vaddr){
+  struct frame *f = &coremap[pa >> PGSHIFT];
+
+  f->owner = p;
+  f->vaddr = vaddr;
+}
+
+//the process frame #i was last given to, and its vaddr there (0 if none)
+struct proc*
+frame_owner(uint i, void **vaddr){
+  struct frame *f = &coremap[i];
+
+  *vaddr = f->vaddr;
+  return f->owner;
+}
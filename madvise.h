@@ -0,0 +1,8 @@
+// Advice to madvise: how a process will use a range of its pages.
+
+#define MADV_NORMAL     0   // no advice: the replacement policy judges by itself
+#define MADV_RANDOM     1   // no readahead on a fault
+#define MADV_SEQUENTIAL 2   // read ahead a full window, page out first the pages the
+                            // stream moved past (GLOBAL: they get no second chance)
+#define MADV_WILLNEED   3   // page the range in from swap now
+#define MADV_DONTNEED   4   // free the range: it reads back as zeros, or from the program file
@@ -3,6 +3,7 @@
 #include "param.h"
 #include "memlayout.h"
 #include "mmu.h"
+#include "pgstat.h"
 #include "proc.h"
 #include "x86.h"
 
@@ -30,10 +31,19 @@ main(void)
   tvinit();        // trap vectors
   binit();         // buffer cache
   fileinit();      // file table
+  swapinit();      // swap slots
+  traceinit();     // paging event trace
   ideinit();       // disk 
   startothers();   // start other processors
   kinit2(P2V(4*1024*1024), P2V(PHYSTOP)); // must come after startothers()
   userinit();      // first user process
+#ifndef NONE
+  zeroinit();      // shared zero frame
+  kswapdinit();    // page-out and aging daemons
+#ifdef KSM
+  ksminit();       // same-page merging
+#endif
+#endif
   mpmain();        // finish this processor's setup
 }
 
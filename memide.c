@@ -5,6 +5,7 @@
 #include "defs.h"
 #include "param.h"
 #include "mmu.h"
+#include "pgstat.h"
 #include "proc.h"
 #include "x86.h"
 #include "traps.h"
@@ -58,3 +59,24 @@ iderw(struct buf *b)
     memmove(b->data, p, BSIZE);
   b->flags |= B_VALID;
 }
+
+// Read (or, if write, write) n whole pages starting at sector of dev.
+void
+iderwpages(uint dev, uint sector, char **pages, int n, int write)
+{
+  uchar *p;
+  int i;
+
+  if(dev != 1)
+    panic("iderwpages: request not for disk 1");
+  if(sector + n*(PGSIZE/BSIZE) > disksize)
+    panic("iderwpages: block out of range");
+
+  p = memdisk + sector*BSIZE;
+  for(i = 0; i < n; i++, p += PGSIZE){
+    if(write)
+      memmove(p, pages[i], PGSIZE);
+    else
+      memmove(pages[i], p, PGSIZE);
+  }
+}
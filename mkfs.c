@@ -109,6 +109,8 @@ main(int argc, char *argv[])
 
   for(i = 0; i < FSSIZE; i++)
     wsect(i, zeroes);
+  // make room for the swap area after the file system
+  wsect(SWAPSTART + NSWAPPAGES*(4096/BSIZE) - 1, zeroes);
 
   memset(buf, 0, sizeof(buf));
   memmove(buf, &sb, sizeof(sb));
@@ -110,9 +110,38 @@ struct segdesc {
 //  \--- PDX(va) --/ \--- PTX(va) --/
 //TASK1
 
-#define MAX_PSYC_PAGES 16
-#define MAX_TOTAL_PAGES 32
+#define MAX_PSYC_PAGES 16   // pages of RAM a process starts with (see PFF)
+#define MAX_PINNED 8      // mlock: pages a process may pin, fewer than MAX_PSYC_PAGES
+#define MIN_FREE_PAGES 64  // GLOBAL: free frames kept for the kernel before paging out
+#define PSYC_LOW 2         // kswapd: wake when fewer RAM pages than this are left to a process
+#define PSYC_HIGH 4        // kswapd: page out until this many are left
+#define FREE_LOW (2*MIN_FREE_PAGES)   // GLOBAL kswapd: wake below this many free frames
+#define FREE_HIGH (4*MIN_FREE_PAGES)  // GLOBAL kswapd: page out until this many are free
+#define WS_TAU 20          // WSCLOCK: ticks of process time a page stays in the working set
+#define CP_COLD_INIT 4     // CLOCKPRO: initial number of RAM pages kept for cold pages
+#define CP_MIN_COLD 1
+#define CP_RECENT 0xC0000000  // CLOCKPRO: ages of a hot page the ager saw used in its last two ticks
+#define NADAPT 4           // ADAPT: candidate policies (NFUA, LAPA, SCFIFO, AQ)
+#define NHEAP 2            // NFUA, LAPA: page heaps a process keeps (see heap_get)
+#define ADAPT_GHOSTS MAX_PSYC_PAGES   // ADAPT: pages remembered per candidate's ghost list
+#define ADAPT_WINDOW 32    // ADAPT: faults the candidates are compared over
+#define ADAPT_MARGIN 2     // ADAPT: fewer misses a candidate needs to take over
+#define AGE_INTERVAL 1     // ticks between two harvests of the accessed bits (aging)
+#define RA_WINDOW 4        // pages read ahead of a swap-in fault, by default
+#define MAX_RA_WINDOW 8
+#define PFF_WINDOW 10      // PFF: ticks of process time a fault rate is taken over
+#define PFF_HIGH 4         // PFF: more faults than this in a window grow the RAM allowance
+#define PFF_LOW 1          // PFF: fewer faults than this shrink it
+#define PFF_STEP 4         // PFF: pages the allowance grows or shrinks by
+#define PFF_MIN (MAX_PINNED + PSYC_HIGH)   // PFF: the smallest allowance
+#define PFF_MAX 256        // PFF: the largest (the page queue holds 1024)
+#define KSM_BATCH 128      // ksmd: pages scanned per pass
+#define KSM_SLEEP 10       // ksmd: ticks between passes
+#define KSM_NHASH 512      // ksmd: frames remembered for merging, by checksum
+#define PMETA_LEAF 64      // page records in one meta-data leaf page
+#define PMETA_NDIR 8       // meta-data directory pages, each covers NPDENTRIES leaves
 #define PTE_PG 0x200 // Paged out to secondary storage
+#define PTE_COW 0x800 // Shared copy-on-write, read-only until written
 
 // page directory index
 #define PDX(va)         (((uint)(va) >> PDXSHIFT) & 0x3FF)
@@ -127,8 +156,6 @@ struct segdesc {
 #define NPDENTRIES      1024    // # directory entries per page directory
 #define NPTENTRIES      1024    // # PTEs per page table
 #define PGSIZE          4096    // bytes mapped by a page
-//added for task 1.1- TODO: Find different way.
-#define PGFILE_FULL_ERR PGSIZE * MAX_TOTAL_PAGES  * 10
 
 
 #define PGSHIFT         12      // log2(PGSIZE)
@@ -154,6 +181,11 @@ struct segdesc {
 #define PTE_ADDR(pte)   ((uint)(pte) & ~0xFFF)
 #define PTE_FLAGS(pte)  ((uint)(pte) &  0xFFF)
 
+// Swap slot of a paged out entry (PTE_PG set, PTE_P clear), kept in the address bits
+#define PTE_SLOT(pte)   (PTE_ADDR(pte) >> PGSHIFT)
+#define SLOT_PTE(slot)  ((uint)(slot) << PGSHIFT)
+#define ZERO_SLOT       0xFFFFF   // slot of a page paged out holding only zeros: no swap space
+
 #ifndef __ASSEMBLER__
 typedef uint pte_t;
 
@@ -7,8 +7,13 @@
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
+#define NSEG          4  // max loadable segments of a program
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
 #define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
 #define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
 #define FSSIZE       1000  // size of file system in blocks
+#define SWAPSTART    FSSIZE  // first block of the swap area, which follows the file system
+#define NSWAPPAGES   1024  // pages in the swap area
+#define ZPOOL_PAGES    64  // max frames of the compressed swap pool (ZSWAP)
+#define NTRACE        512  // paging events kept per CPU (see trace.c)
 
@@ -0,0 +1,275 @@
+// Paging benchmark: runs workloads over more pages than fit in RAM, and
+// prints one line per workload with its time and the paging counters of
+// the process and of the children it reaped (fork) over it.
+// usage: pgbench [-p pages] [-n passes] [-r refs] [-h hot] [-f forks]
+//                [-P policy] [-a advice] [workload...]
+//
+// workloads (all of them, in this order, if none is given):
+//   seq    write pages pages in order, then read them passes times over
+//   rand   refs references to pages picked at random among pages
+//   hot    a scan of pages cold pages, with references to hot hot pages
+//          at random in between (four per cold page)
+//   fork   fill pages pages and fork forks children that all write them
+//   grow   grow the heap by pages pages, one at a time, touching the new
+//          page and an older one at random each time
+//
+// -a seq or -a rand passes MADV_SEQUENTIAL or MADV_RANDOM to madvise for
+// the memory of every workload.
+//
+// Every line reads "pgbench <workload> key=value...", times in ticks.
+// The last line, "pgbench done", marks the end (see make bench).
+
+#include "types.h"
+#include "user.h"
+#include "pgstat.h"
+#include "madvise.h"
+
+#define PGSIZE 4096
+
+int pages = 64;
+int passes = 4;
+int refs = 4096;
+int hot = 8;
+int forks = 4;
+uint seed = 1;
+int advice = MADV_NORMAL;
+
+struct pgstat base;
+int t0;
+
+uint
+rnd(void)
+{
+  seed = seed * 1103515245 + 12345;
+  return seed >> 8;
+}
+
+// the counters of this process and the children it reaped so far,
+// 0 if it can't get them
+int
+counters(struct pgstat *st)
+{
+  uint *c = (uint*)&st->c, *cc = (uint*)&st->cc;
+  int i;
+
+  if(pgstat(getpid(), st) < 0){
+    memset(st, 0, sizeof(*st));
+    return 0;
+  }
+  for(i = 0; i < sizeof(st->c)/sizeof(uint); i++)
+    c[i] += cc[i];
+  return 1;
+}
+
+void
+start(void)
+{
+  counters(&base);
+  t0 = uptime();
+}
+
+// print the line of workload name, since start
+void
+report(char *name, int npages)
+{
+  struct pgstat st;
+  struct pgcount *c = &st.c, *b = &base.c;
+  int t = uptime() - t0;
+
+  counters(&st);
+  printf(1, "pgbench %s pages=%d ticks=%d minor=%d major=%d in=%d out=%d"
+         " swapkb=%d victims=%d scanned=%d frames=%d\n", name, npages, t,
+         c->minor - b->minor, c->major - b->major,
+         c->pages_in - b->pages_in, c->pages_out - b->pages_out,
+         (c->swap_read - b->swap_read + c->swap_written - b->swap_written) / 1024,
+         c->scans - b->scans, c->scanned - b->scanned, st.frames);
+}
+
+// n pages of fresh heap, 0 if there's no memory
+char*
+grab(int n)
+{
+  char *a = sbrk(n*PGSIZE);
+
+  if(a == (char*)-1){
+    printf(2, "pgbench: sbrk %d pages failed\n", n);
+    return 0;
+  }
+  if(advice != MADV_NORMAL)
+    madvise(a, n*PGSIZE, advice);
+  return a;
+}
+
+void
+seqscan(void)
+{
+  volatile char *a;
+  int i, j;
+
+  if((a = grab(pages)) == 0)
+    return;
+  start();
+  for(i = 0; i < pages; i++)
+    a[i*PGSIZE] = i;
+  for(j = 0; j < passes; j++)
+    for(i = 0; i < pages; i++)
+      (void)a[i*PGSIZE];
+  report("seq", pages);
+  sbrk(-pages*PGSIZE);
+}
+
+void
+random(void)
+{
+  char *a;
+  int i;
+
+  if((a = grab(pages)) == 0)
+    return;
+  for(i = 0; i < pages; i++)
+    a[i*PGSIZE] = i;
+  start();
+  for(i = 0; i < refs; i++)
+    a[(rnd() % pages)*PGSIZE + (i & (PGSIZE-1))]++;
+  report("rand", pages);
+  sbrk(-pages*PGSIZE);
+}
+
+void
+hotcold(void)
+{
+  char *a;
+  int i, j;
+
+  if((a = grab(hot + pages)) == 0)
+    return;
+  for(i = 0; i < hot; i++)
+    a[i*PGSIZE] = i;
+  start();
+  for(i = 0; i < pages; i++){
+    for(j = 0; j < 4; j++)
+      a[(rnd() % hot)*PGSIZE]++;
+    a[(hot + i)*PGSIZE] = i;
+  }
+  report("hot", hot + pages);
+  sbrk(-(hot + pages)*PGSIZE);
+}
+
+void
+forkrun(void)
+{
+  char *a;
+  int i, k, n = 0;
+
+  if((a = grab(pages)) == 0)
+    return;
+  start();
+  for(i = 0; i < pages; i++)
+    a[i*PGSIZE] = i;
+  for(k = 0; k < forks; k++){
+    int pid = fork();
+    if(pid < 0)
+      break;
+    if(pid == 0){
+      for(i = 0; i < pages; i++)
+        a[i*PGSIZE] = k;
+      exit();
+    }
+    n++;
+  }
+  while(n-- > 0)
+    wait();
+  report("fork", pages);
+  sbrk(-pages*PGSIZE);
+}
+
+void
+growheap(void)
+{
+  char *a = sbrk(0), *p;
+  int i;
+
+  start();
+  for(i = 0; i < pages; i++){
+    if((p = grab(1)) == 0)
+      break;
+    *p = i;
+    a[(rnd() % (i + 1))*PGSIZE]++;
+  }
+  report("grow", i);
+  sbrk(-i*PGSIZE);
+}
+
+struct {
+  char *name;
+  void (*run)(void);
+} workloads[] = {
+  { "seq",  seqscan },
+  { "rand", random },
+  { "hot",  hotcold },
+  { "fork", forkrun },
+  { "grow", growheap },
+};
+
+#define NWORK (sizeof(workloads)/sizeof(workloads[0]))
+
+void
+usage(void)
+{
+  printf(2, "usage: pgbench [-p pages] [-n passes] [-r refs] [-h hot] [-f forks] [-P policy] [-a seq|rand] [workload...]\n");
+  exit();
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, k, n;
+
+  for(i = 1; i < argc && argv[i][0] == '-'; i += 2){
+    if(i + 1 == argc)
+      usage();
+    n = atoi(argv[i+1]);
+    switch(argv[i][1]){
+    case 'p': pages = n; break;
+    case 'n': passes = n; break;
+    case 'r': refs = n; break;
+    case 'h': hot = n; break;
+    case 'f': forks = n; break;
+    case 'a':
+      if(strcmp(argv[i+1], "seq") == 0)
+        advice = MADV_SEQUENTIAL;
+      else if(strcmp(argv[i+1], "rand") == 0)
+        advice = MADV_RANDOM;
+      else
+        usage();
+      break;
+    case 'P':
+      if(pgpolicy(getpid(), argv[i+1]) < 0){
+        printf(2, "pgbench: no policy %s\n", argv[i+1]);
+        exit();
+      }
+      break;
+    default:
+      usage();
+    }
+  }
+  if(pages < 1 || hot < 1 || passes < 0 || refs < 0 || forks < 0)
+    usage();
+  printf(1, "pgbench start pages=%d passes=%d refs=%d hot=%d forks=%d advice=%d\n",
+         pages, passes, refs, hot, forks, advice);
+  if(i == argc)
+    for(k = 0; k < NWORK; k++)
+      workloads[k].run();
+  for(; i < argc; i++){
+    for(k = 0; k < NWORK; k++)
+      if(strcmp(argv[i], workloads[k].name) == 0)
+        break;
+    if(k == NWORK){
+      printf(2, "pgbench: no workload %s\n", argv[i]);
+      continue;
+    }
+    workloads[k].run();
+  }
+  printf(1, "pgbench done\n");
+  exit();
+}
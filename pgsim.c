@@ -0,0 +1,408 @@
+// pgsim: replay page references through the page replacement policies
+// of the kernel (policy.c, built for the host) and count what each one
+// pays for them.
+//
+// usage: pgsim [-m frames] [-t refs] [-w percent] [-s seed] [-p pid] workload...
+//
+// A workload is a synthetic reference string or a recorded trace:
+//   seq:N:P       P sequential passes over N pages
+//   rand:N:R      R references to pages picked at random among N
+//   hot:H:C:R     R references, 9 of 10 to H hot pages at random,
+//                 the rest a sequential scan over C cold pages
+//   file          page faults of process pid (the first one seen if
+//                 there's no -p) in the output of the pgtrace program
+//
+// The process gets a fixed allowance of frames pages of RAM (by default
+// MAX_PSYC_PAGES; there's no PFF here).  A synthetic workload ages the
+// pages every refs references (one tick), a recorded one by the ticks
+// recorded in it; -w makes that percentage of the synthetic references
+// writes.  A recorded trace only holds the faults, so it's replayed as a
+// string of reads: the policies see it the way the kernel's ager does,
+// not reference by reference.
+//
+// For every policy, one line:
+//   policy refs faults new evictions writes scanned mrefs/s
+// faults - references to paged out pages; new - first references;
+// writes - evictions that wrote the page (dirty, or not in swap);
+// scanned - queue (or NFUA and LAPA's heap) entries looked at per eviction.
+//
+// NFUA, LAPA, SCFIFO and AQ replay millions of references a second at any
+// -m; the hands of WSCLOCK and CLOCKPRO go around all the pages in RAM per
+// eviction, so past a few hundred frames they slow down with -m.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <time.h>
+
+#define exit xv6_exit     // avoid clashes with the host's libc
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "pgstat.h"
+#include "proc.h"
+#include "pgtrace.h"
+#undef exit
+
+#define REF_W     0x80000000    // the reference is a write
+#define REF_TICK  0x40000000    // not a reference: the clock ticks (aging)
+
+uint *refs;             // the reference string: page numbers, REF_W, or REF_TICK
+int nrefs, maxrefs;
+uint npages;            // page numbers in use are below npages
+
+struct page *pages;     // the simulated process: its page records
+pte_t *ptes;            // and page table entries, by page number
+uint *resident;         // pages in RAM, in no order
+uint *rpos;             // and the position of each in resident, by page number
+uint nresident;
+
+int frames = MAX_PSYC_PAGES;
+int interval = 100;
+int wpercent = 25;
+int tracepid = -1;
+uint seed = 1;
+
+// the parts of the kernel policy.c uses
+
+void
+panic(char *s)
+{
+  fprintf(stderr, "pgsim: panic: %s\n", s);
+  abort();
+}
+
+void
+cprintf(char *fmt, ...)
+{
+  va_list ap;
+
+  va_start(ap, fmt);
+  vprintf(fmt, ap);
+  va_end(ap);
+}
+
+char*
+kalloc(void)
+{
+  return aligned_alloc(PGSIZE, PGSIZE);
+}
+
+struct page*
+find_page(struct proc *p, const void *vaddr)
+{
+  uint vpn = (uint)vaddr >> PGSHIFT;
+
+  if(vpn >= npages || !pages[vpn].exists)
+    return 0;
+  return &pages[vpn];
+}
+
+pte_t*
+pgpte(struct proc *p, void *vaddr)
+{
+  return &ptes[(uint)vaddr >> PGSHIFT];
+}
+
+void
+ra_account(struct page *pg, uint pte, int leaving)
+{
+}
+
+void
+tlb_flush_page(pde_t *pgdir, void *va)
+{
+}
+
+int
+numOfPagedIn(struct proc *p)
+{
+  return p->paging_meta.num_in_ram;
+}
+
+// building the reference strings
+
+void
+addref(uint r)
+{
+  if(nrefs == maxrefs){
+    maxrefs = maxrefs ? 2*maxrefs : 1 << 16;
+    if((refs = realloc(refs, maxrefs*sizeof(refs[0]))) == 0){
+      fprintf(stderr, "pgsim: out of memory\n");
+      exit(1);
+    }
+  }
+  if(!(r & REF_TICK) && (r & ~REF_W) >= npages)
+    npages = (r & ~REF_W) + 1;
+  refs[nrefs++] = r;
+}
+
+// xorshift - fast, and the same string on every host
+uint
+rnd(void)
+{
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+// a synthetic reference to page vpn, a write wpercent of the time
+void
+synref(uint vpn)
+{
+  if(nrefs % (interval + 1) == interval)
+    addref(REF_TICK);
+  addref(vpn | (rnd() % 100 < wpercent ? REF_W : 0));
+}
+
+int
+cmpseq(const void *a, const void *b)
+{
+  const struct pgevent *x = a, *y = b;
+
+  return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+// the faults of tracepid in pgtrace output file, in the order of seq
+// (the events come in per-CPU batches).  returns 0 if it can't be read.
+int
+loadtrace(char *file)
+{
+  FILE *f;
+  struct pgevent *ev = 0;
+  long n = 0, max = 0, i;
+  uint tick = 0;
+
+  if((f = fopen(file, "rb")) == 0)
+    return 0;
+  for(;;){
+    if(n == max){
+      max = max ? 2*max : 1 << 12;
+      if((ev = realloc(ev, max*sizeof(ev[0]))) == 0){
+        fprintf(stderr, "pgsim: out of memory\n");
+        exit(1);
+      }
+    }
+    if(fread(&ev[n], sizeof(ev[0]), 1, f) != 1)
+      break;
+    n++;
+  }
+  fclose(f);
+  qsort(ev, n, sizeof(ev[0]), cmpseq);
+  for(i = 0; i < n; i++){
+    if(ev[i].kind != PGEV_FAULT || ev[i].vaddr >= KERNBASE)
+      continue;
+    if(tracepid < 0)
+      tracepid = ev[i].pid;
+    if(ev[i].pid != tracepid)
+      continue;
+    //32 idle ticks leave every age 0 - more only move WSCLOCK's clock on
+    if(tick == 0 || ev[i].tick - tick > 32)
+      tick = ev[i].tick - (tick != 0);
+    for(; tick != ev[i].tick; tick++)
+      addref(REF_TICK);
+    addref(ev[i].vaddr >> PGSHIFT);
+  }
+  free(ev);
+  return 1;
+}
+
+// add the references of workload w.  returns 0 if w is no workload.
+int
+workload(char *w)
+{
+  uint a, b, c, i, cold = 0;
+
+  if(sscanf(w, "seq:%u:%u", &a, &b) == 2){
+    for(; b > 0; b--)
+      for(i = 0; i < a; i++)
+        synref(i);
+  } else if(sscanf(w, "rand:%u:%u", &a, &b) == 2 && a > 0){
+    for(i = 0; i < b; i++)
+      synref(rnd() % a);
+  } else if(sscanf(w, "hot:%u:%u:%u", &a, &b, &c) == 3 && a > 0 && b > 0){
+    for(i = 0; i < c; i++)
+      synref(rnd() % 10 ? rnd() % a : a + cold++ % b);
+  } else if(!loadtrace(w))
+    return 0;
+  return 1;
+}
+
+// replaying
+
+struct result {
+  uint faults, new, evictions, writes;
+  uint scanned;             // per eviction
+  double secs;
+};
+
+// make room for one more page in RAM
+void
+evict(struct proc *p, struct result *r)
+{
+  void *vaddr = select_page_to_back(p);
+  struct page *pg = find_page(p, vaddr);
+  pte_t *pte = pgpte(p, vaddr);
+
+  //a clean page still in swap (see out_slot) costs no write
+  if((*pte & PTE_D) || pg->slot < 0){
+    pg->slot = (uint)vaddr >> PGSHIFT;
+    r->writes++;
+  }
+  page_out_meta(p, vaddr);
+  *pte = 0;
+  r->evictions++;
+  resident[rpos[(uint)vaddr >> PGSHIFT]] = resident[--nresident];
+  rpos[resident[nresident]] = rpos[(uint)vaddr >> PGSHIFT];
+}
+
+// page vpn is now in RAM
+void
+arrive(uint vpn)
+{
+  rpos[vpn] = nresident;
+  resident[nresident++] = vpn;
+}
+
+// one aging pass over the pages in RAM, as age_process_pages
+void
+tick(struct proc *p)
+{
+  uint i, vpn, acc;
+
+  p->vticks++;
+  for(i = 0; i < nresident; i++){
+    vpn = resident[i];
+    acc = ptes[vpn] & PTE_A;
+    ptes[vpn] &= ~PTE_A;
+    age_page(p, &pages[vpn], acc != 0);
+  }
+  policy_aged(p);
+}
+
+void
+replay(int policy, struct result *r)
+{
+  struct proc *p;
+  struct timespec t0, t1;
+  struct page *pg;
+  void *vaddr;
+  uint vpn;
+  int i;
+
+  p = calloc(1, sizeof(*p));
+  pages = calloc(npages, sizeof(pages[0]));
+  ptes = calloc(npages, sizeof(ptes[0]));
+  resident = calloc(npages, sizeof(resident[0]));
+  rpos = calloc(npages, sizeof(rpos[0]));
+  if(p == 0 || (npages && (pages == 0 || ptes == 0 || resident == 0 || rpos == 0))){
+    fprintf(stderr, "pgsim: out of memory\n");
+    exit(1);
+  }
+  r->faults = r->new = r->evictions = r->writes = 0;
+  nresident = 0;
+  p->pid = 3;
+  p->paging_meta.frames = frames;
+  policy_set(p, policy);
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for(i = 0; i < nrefs; i++){
+    if(refs[i] & REF_TICK){
+      tick(p);
+      continue;
+    }
+    vpn = refs[i] & ~REF_W;
+    vaddr = (void*)(uintptr_t)(vpn << PGSHIFT);
+    pg = &pages[vpn];
+    if(!pg->exists){
+      if(numOfPagedIn(p) >= frames)
+        evict(p, r);
+      if(!page_new_meta(p, pg, vaddr))
+        panic("page_new_meta");
+      arrive(vpn);
+      ptes[vpn] = PTE_P;
+      r->new++;
+    } else if(pg->in_back){
+      policy_fault(p, vaddr);
+      if(numOfPagedIn(p) >= frames)
+        evict(p, r);
+      page_in_meta(p, vaddr);
+      arrive(vpn);
+      ptes[vpn] = PTE_P;
+      r->faults++;
+    }
+    ptes[vpn] |= PTE_A;
+    if(refs[i] & REF_W){
+      ptes[vpn] |= PTE_D;
+      pg->slot = -1;                    //the copy in swap is stale
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  r->secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+  r->scanned = p->pgc.scans ? p->pgc.scanned / p->pgc.scans : 0;
+  free(p->paging_meta.pq.slots);
+  for(i = 0; i < NHEAP; i++)
+    free(p->paging_meta.heap[i].slots);
+  free(p);
+  free(pages);
+  free(ptes);
+  free(resident);
+  free(rpos);
+}
+
+// replay the references under policy, and print its line
+void
+report(char *name, int policy, int nref)
+{
+  struct result r;
+
+  replay(policy, &r);
+  printf("%s %d %u %u %u %u %u %.2f\n", name, nref, r.faults, r.new,
+         r.evictions, r.writes, r.scanned, r.secs > 0 ? nref / r.secs / 1e6 : 0);
+}
+
+void
+usage(void)
+{
+  fprintf(stderr, "usage: pgsim [-m frames] [-t refs] [-w percent] [-s seed] [-p pid] workload...\n");
+  exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, nref, policy;
+
+  for(i = 1; i < argc && argv[i][0] == '-'; i += 2){
+    if(i + 1 == argc)
+      usage();
+    switch(argv[i][1]){
+    case 'm': frames = atoi(argv[i+1]); break;
+    case 't': interval = atoi(argv[i+1]); break;
+    case 'w': wpercent = atoi(argv[i+1]); break;
+    case 's': seed = atoi(argv[i+1]); break;
+    case 'p': tracepid = atoi(argv[i+1]); break;
+    default: usage();
+    }
+  }
+  if(i == argc || frames < 1 || frames > PGSIZE/sizeof(int) || interval < 1 || seed == 0)
+    usage();
+  for(; i < argc; i++){
+    if(!workload(argv[i])){
+      fprintf(stderr, "pgsim: %s: no such workload or trace\n", argv[i]);
+      exit(1);
+    }
+  }
+  for(nref = i = 0; i < nrefs; i++)
+    nref += !(refs[i] & REF_TICK);
+
+  printf("policy refs faults new evictions writes scanned mrefs/s\n");
+  for(policy = 0; strncmp(policy_name(policy), "-", 2) != 0; policy++)
+    report(policy_name(policy), policy, nref);
+  report("ADAPT", find_policy("ADAPT"), nref);
+  exit(0);
+}
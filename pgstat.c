@@ -0,0 +1,42 @@
+// Print the paging counters of a process, or of the whole system.
+// usage: pgstat [pid]
+
+#include "types.h"
+#include "user.h"
+#include "pgstat.h"
+
+int
+main(int argc, char *argv[])
+{
+  struct pgstat st;
+  int pid, i;
+
+  pid = argc > 1 ? atoi(argv[1]) : 0;
+  if(pgstat(pid, &st) < 0){
+    printf(2, "pgstat: no process %d\n", pid);
+    exit();
+  }
+  printf(1, "faults: %d minor, %d major\n", st.c.minor, st.c.major);
+  printf(1, "pages: %d in, %d out\n", st.c.pages_in, st.c.pages_out);
+  printf(1, "swap: %d KB read, %d KB written\n", st.c.swap_read/1024, st.c.swap_written/1024);
+  printf(1, "victims: %d, %d pages scanned\n", st.c.scans, st.c.scanned);
+  printf(1, "fault service time (cycles):\n");
+  for(i = 0; i < PGLAT_NBUCKET; i++)
+    if(st.c.lat[i])
+      printf(1, "  2^%d\t%d\n", i, st.c.lat[i]);
+  if(pid != 0){
+    printf(1, "ram allowance: %d pages, %d faults in the last window\n", st.frames, st.pff_rate);
+    printf(1, "reaped children: %d minor, %d major faults, %d in, %d out\n",
+           st.cc.minor, st.cc.major, st.cc.pages_in, st.cc.pages_out);
+    exit();
+  }
+  printf(1, "free pages: %d\n", st.free_pages);
+  printf(1, "readahead: %d read, %d hits, %d misses\n", st.ra_reads, st.ra_hits, st.ra_misses);
+  printf(1, "zero pages: %d out, %d in; clean pages out: %d\n",
+         st.zero_outs, st.zero_ins, st.clean_outs);
+  printf(1, "swap pool: %d stored, %d rejected, %d spilled, %d hits, %d misses, %d/%d bytes\n",
+         st.zstores, st.zrejects, st.zspills, st.zhits, st.zmisses, st.zout, st.zin);
+  printf(1, "ksm: %d scanned, %d merged, %d frames saved\n",
+         st.ksm_scanned, st.ksm_merged, st.ksm_saved);
+  exit();
+}
@@ -0,0 +1,40 @@
+// Paging counters, read with the pgstat system call.
+
+#define PGLAT_NBUCKET 32
+
+// Counters of a process, or summed over all of them.
+struct pgcount {
+  uint minor;          // faults served without I/O (copy-on-write, zero fill)
+  uint major;          // faults that read the page from swap or the program file
+  uint pages_in;       // pages read from swap, read-ahead included
+  uint pages_out;      // pages paged out
+  uint swap_read;      // bytes read from swap
+  uint swap_written;   // bytes written to swap
+  uint scans;          // victims selected
+  uint scanned;        // pages looked at to select them
+  uint lat[PGLAT_NBUCKET];  // faults by service time: lat[i] took 2^i to 2^(i+1) cycles
+};
+
+struct pgstat {
+  struct pgcount c;
+  struct pgcount cc;   // of the children it reaped, and theirs, for a pid only
+  uint frames;         // pages of RAM the process is allowed (PFF), for a pid only
+  uint pff_rate;       // its faults on paged out pages in the last PFF window
+  // the rest is system-wide, filled for pid 0 only
+  uint free_pages;
+  uint ra_reads;       // pages read ahead of a swap-in fault
+  uint ra_hits;        // and used
+  uint ra_misses;      // and paged out again unused
+  uint zero_outs;      // all-zero pages paged out without swap space
+  uint zero_ins;
+  uint clean_outs;     // pages paged out without a write
+  uint zstores;        // compressed swap pool (ZSWAP): pages stored
+  uint zrejects;       // pages that did not compress well enough
+  uint zspills;        // pages written to disk since the pool was full
+  uint zhits;          // slot reads served by the pool
+  uint zmisses;        // slot reads that went to disk
+  uint zin, zout;      // bytes before and after compression
+  uint ksm_scanned;    // same-page merging (KSM): pages scanned
+  uint ksm_merged;     // pages mapped to a merged frame
+  uint ksm_saved;      // frames saved by merging
+};
@@ -0,0 +1,74 @@
+// Record the paging events while a command runs, into a file that can be
+// copied out of the image and replayed offline (records of struct pgevent).
+// usage: pgtrace file command [args...]
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+#include "pgtrace.h"
+
+#define NEV 64
+
+struct pgevent ev[NEV];
+
+// move the recorded events to fd. returns 0 once there are none left.
+int
+drain(int fd)
+{
+  int n;
+
+  if((n = pgtrace(PGTRACE_READ, ev, NEV)) <= 0)
+    return 0;
+  if(write(fd, ev, n*sizeof(ev[0])) != n*sizeof(ev[0])){
+    printf(2, "pgtrace: write failed, trace file full\n");
+    exit();
+  }
+  return n;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int fd, pid, drainer, lost, w;
+  struct stat st;
+
+  if(argc < 3){
+    printf(2, "usage: pgtrace file command [args...]\n");
+    exit();
+  }
+  unlink(argv[1]);
+  if((fd = open(argv[1], O_CREATE|O_WRONLY)) < 0){
+    printf(2, "pgtrace: cannot create %s\n", argv[1]);
+    exit();
+  }
+  pgtrace(PGTRACE_START, 0, 0);
+  if((pid = fork()) < 0){
+    printf(2, "pgtrace: fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    exec(argv[2], argv+2);
+    printf(2, "pgtrace: exec %s failed\n", argv[2]);
+    exit();
+  }
+  //empty the rings while the command runs, so they don't fill up
+  if((drainer = fork()) == 0){
+    for(;;){
+      while(drain(fd))
+        ;
+      sleep(1);
+    }
+  }
+  while((w = wait()) != pid && w >= 0)
+    ;
+  kill(drainer);
+  wait();
+  lost = pgtrace(PGTRACE_STOP, 0, 0);
+  while(drain(fd))
+    ;
+  fstat(fd, &st);
+  close(fd);
+  printf(1, "pgtrace: pid %d, %d events, %d lost\n", pid, st.size/sizeof(ev[0]), lost);
+  exit();
+}
@@ -0,0 +1,20 @@
+// Paging events, recorded by the kernel and read with the pgtrace system call.
+
+// pgtrace commands
+#define PGTRACE_START 1   // drop the events so far, and record from now on
+#define PGTRACE_STOP  2   // stop recording; returns the number of events lost
+#define PGTRACE_READ  3   // move up to n recorded events to buf; returns how many
+
+// event kinds
+#define PGEV_FAULT  1     // page fault at vaddr
+#define PGEV_PAGEIN 2     // page vaddr read back into RAM
+#define PGEV_EVICT  3     // page vaddr paged out
+
+struct pgevent {
+  uint seq;        // order of the events, across CPUs
+  uint tick;
+  uint vaddr;
+  ushort pid;
+  uchar kind;
+  uchar policy;    // page replacement policy of the process, 0xff if none
+};
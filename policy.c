@@ -0,0 +1,897 @@
+// Page replacement: the queue of pages in RAM, the policies that choose
+// the page to page out, and the per-page meta-data they keep.
+//
+// The code here sees a process only through its paging meta-data and
+// pgpte, find_page, ra_account and tlb_flush_page, so it also builds on
+// the host, where pgsim replays page reference traces through it.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "pgstat.h"
+#include "proc.h"
+#include "madvise.h"
+
+#ifndef NONE
+
+// The page queue is a ring of page numbers, one page long.
+// Every queued page remembers its ring position (qslot), so removing a page
+// only marks its position as empty; empty positions are skipped by dequeue
+// and squeezed out when the ring fills up.
+#define PQ_CAP          ((int)(PGSIZE / sizeof(int)))
+
+//position of the i'th entry from the head of the queue
+#define PQ_POS(pq, i)   (((pq)->head + (i)) % PQ_CAP)
+
+static void heap_add(struct proc *p, struct page *pg);
+static void heap_del(struct proc *p, struct page *pg);
+
+//the queued page at position pos, 0 for a removed entry
+static struct page*
+queued_page(struct proc *pr, int pos){
+  int vpn = pr->paging_meta.pq.slots[pos];
+
+  pr->paging_meta.pq.looks++;
+  if(vpn < 0)
+    return 0;
+  return find_page(pr, (void*)(vpn << PGSHIFT));
+}
+
+//squeeze the removed entries out of the ring, keeping the queue order.
+static void
+compact_queue(struct proc *pr){
+  struct page_queue *pq=&pr->paging_meta.pq;
+  struct page *pg;
+  int i, n = 0;
+
+  for(i=0; i<pq->count; i++){
+    if((pg = queued_page(pr, PQ_POS(pq,i))) == 0)
+      continue;
+    pq->slots[PQ_POS(pq,n)] = pq->slots[PQ_POS(pq,i)];
+    pg->qslot = PQ_POS(pq,n);
+    n++;
+  }
+  pq->count=n;
+}
+
+//add a page at the tail of the queue. returns 0 if out of memory.
+int
+enqueue(struct proc *pr,struct page *pg){
+  struct page_queue *pq=&pr->paging_meta.pq;
+  int pos;
+
+#ifdef GLOBAL
+  //the global clock runs over the core map, there is no per-process queue
+  pg->qslot=-1;
+  return 1;
+#endif
+  if(pq->slots == 0){
+    if((pq->slots = (int*)kalloc()) == 0)
+      return 0;
+    pq->head=0;
+    pq->count=0;
+  }
+  if(pq->count == PQ_CAP)
+    compact_queue(pr);
+  if(pq->count == PQ_CAP)
+    panic("enqueue");
+  pos=PQ_POS(pq,pq->count);
+  pq->slots[pos]=(uint)pg->vaddr >> PGSHIFT;
+  pg->qslot=pos;
+  pg->qseq=pq->seq++;
+  pq->count++;
+  heap_add(pr,pg);
+  return 1;
+}
+
+//remove the page at the head of the queue, return it (0 if the queue is empty)
+struct page*
+dequeue(struct proc *pr){
+  struct page_queue *pq=&pr->paging_meta.pq;
+  struct page *pg;
+
+  while(pq->count > 0){
+    pg=queued_page(pr,pq->head);
+    pq->head=(pq->head + 1) % PQ_CAP;
+    pq->count--;
+    if(pg == 0)             //removed entry, skip it
+      continue;
+    pg->qslot=-1;
+    heap_del(pr,pg);
+    return pg;
+  }
+  return 0;
+}
+
+//remove a page from the middle of the queue - it keeps its position until dequeue skips it.
+void
+free_from_queue(struct proc *pr,struct page *pg){
+  struct page_queue *pq=&pr->paging_meta.pq;
+
+  if(pg->qslot < 0)
+    return;
+  pq->slots[pg->qslot]=-1;
+  pg->qslot=-1;
+  heap_del(pr,pg);
+  //drop removed entries off both ends right away
+  while(pq->count > 0 && pq->slots[pq->head] < 0){
+    pq->head=(pq->head + 1) % PQ_CAP;
+    pq->count--;
+  }
+  while(pq->count > 0 && pq->slots[PQ_POS(pq,pq->count - 1)] < 0)
+    pq->count--;
+}
+
+// counter number of 1's in a number
+static uint
+count_set_bits(uint number){
+  number = number - ((number >> 1) & 0x55555555);
+  number = (number & 0x33333333) + ((number >> 2) & 0x33333333);
+  number = (number + (number >> 4)) & 0x0f0f0f0f;
+  return (number * 0x01010101) >> 24;
+}
+
+// NFUA and LAPA take the queued page with the smallest key (NFUA: age;
+// LAPA: the intervals it was accessed in, then age2), the first queued of
+// equal ones.  Rather than scan the queue on every eviction, each keeps the
+// queued pages in a binary heap by its key.  A heap is built on the first
+// select after an aging pass changed the keys, and the queue operations
+// keep it up until the next one.
+enum { H_NFUA, H_LAPA };
+
+//1 if page a goes before page b in heap h
+static int
+heap_before(int h, struct page *a, struct page *b){
+  uint ka = h == H_NFUA ? a->age : count_set_bits(a->age2);
+  uint kb = h == H_NFUA ? b->age : count_set_bits(b->age2);
+
+  if(ka == kb && h == H_LAPA){
+    ka = a->age2;
+    kb = b->age2;
+  }
+  if(ka != kb)
+    return ka < kb;
+  return (int)(a->qseq - b->qseq) < 0;
+}
+
+//the page at position i of heap h
+static struct page*
+heap_page(struct proc *p, int h, int i){
+  p->paging_meta.pq.looks++;
+  return find_page(p, (void*)(p->paging_meta.heap[h].slots[i] << PGSHIFT));
+}
+
+static void
+heap_put(struct proc *p, int h, int i, struct page *pg){
+  p->paging_meta.heap[h].slots[i] = (uint)pg->vaddr >> PGSHIFT;
+  pg->hpos[h] = i;
+}
+
+//put pg at position i of heap h, or below it where it belongs
+static void
+heap_down(struct proc *p, int h, int i, struct page *pg){
+  struct page_heap *hp = &p->paging_meta.heap[h];
+  struct page *c;
+  int k;
+
+  while((k = 2*i + 1) < hp->count){
+    c = heap_page(p,h,k);
+    if(k + 1 < hp->count && heap_before(h,heap_page(p,h,k+1),c))
+      c = heap_page(p,h,++k);
+    if(!heap_before(h,c,pg))
+      break;
+    heap_put(p,h,i,c);
+    i = k;
+  }
+  heap_put(p,h,i,pg);
+}
+
+//put pg at position i of heap h, or where it belongs above or below it
+static void
+heap_fix(struct proc *p, int h, int i, struct page *pg){
+  struct page *up;
+
+  if(i == 0 || !heap_before(h,pg,heap_page(p,h,(i-1)/2))){
+    heap_down(p,h,i,pg);
+    return;
+  }
+  while(i > 0 && heap_before(h,pg,up = heap_page(p,h,(i-1)/2))){
+    heap_put(p,h,i,up);
+    i = (i-1)/2;
+  }
+  heap_put(p,h,i,pg);
+}
+
+//add pg, just queued, to the heaps that are built
+static void
+heap_add(struct proc *p, struct page *pg){
+  struct page_heap *hp;
+  int h;
+
+  for(h = 0; h < NHEAP; h++){
+    hp = &p->paging_meta.heap[h];
+    if(hp->valid)
+      heap_fix(p,h,hp->count++,pg);
+  }
+}
+
+//take pg, leaving the queue, out of the heaps that are built
+static void
+heap_del(struct proc *p, struct page *pg){
+  struct page_heap *hp;
+  struct page *last;
+  int h;
+
+  for(h = 0; h < NHEAP; h++){
+    hp = &p->paging_meta.heap[h];
+    if(!hp->valid)
+      continue;
+    last = heap_page(p,h,--hp->count);
+    if(last != pg)
+      heap_fix(p,h,pg->hpos[h],last);
+  }
+}
+
+//heap h of p, built over the queue if it isn't.  0 if out of memory.
+static struct page_heap*
+heap_get(struct proc *p, int h){
+  struct page_queue *pq=&p->paging_meta.pq;
+  struct page_heap *hp=&p->paging_meta.heap[h];
+  struct page *pg;
+  int i;
+
+  if(hp->valid)
+    return hp;
+  if(hp->slots == 0 && (hp->slots = (int*)kalloc()) == 0)
+    return 0;
+  hp->count = 0;
+  for(i = 0; i<pq->count; i++)
+    if((pg = queued_page(p,PQ_POS(pq,i))) != 0)
+      heap_put(p,h,hp->count++,pg);
+  for(i = hp->count/2 - 1; i >= 0; i--)
+    heap_down(p,h,i,heap_page(p,h,i));
+  hp->valid = 1;
+  return hp;
+}
+
+//the first page of heap h; a scan of the queue if there's no memory for it
+static void*
+heap_select(struct proc *p, int h){
+  struct page_queue *pq=&p->paging_meta.pq;
+  struct page_heap *hp=heap_get(p,h);
+  struct page *min_page = 0, *pg;
+  int i;
+
+  if(hp && hp->count > 0)
+    return heap_page(p,h,0)->vaddr;
+  //every page in the queue exists and is NOT in the back
+  for(i = 0; hp == 0 && i<pq->count; i++){
+    if((pg = queued_page(p,PQ_POS(pq,i))) == 0)
+      continue;
+    if(min_page == 0 || heap_before(h,pg,min_page))
+      min_page=pg;
+  }
+  if(min_page == 0)
+    panic("select_page_to_back: empty queue");
+  //return this page's vaddr - it leaves the queue (and the heap) when paged out
+  return min_page->vaddr;
+}
+
+// Page replacement policies.  A process pages out by its own policy
+// (p->policy), set at runtime by the pgpolicy system call.  New processes
+// get pg_policy, which is SELECTION at boot, and a child keeps the policy
+// of its parent.  Every policy runs over the queue of pages in RAM.
+
+//NFUA: the page with the smallest age
+static void*
+nfua_select(struct proc *p){
+  return heap_select(p,H_NFUA);
+}
+
+//LAPA: the page accessed in the fewest aging intervals, then the smallest age
+static void*
+lapa_select(struct proc *p){
+  return heap_select(p,H_LAPA);
+}
+
+//SCFIFO: the oldest page, skipping the accessed ones (second chance)
+static void*
+scfifo_select(struct proc *p){
+  struct page *current;
+
+  while((current = dequeue(p)) != 0){
+    pte_t *e= pgpte(p,current->vaddr);  //get the PTE
+    if((*e & PTE_A) > 0){              // if accessed
+        ra_account(current,*e,0);
+        *e &=~PTE_A;                   // clear Accessed bit
+        tlb_flush_page(p->pgdir,current->vaddr);
+        enqueue(p,current);            // give second chance
+    }
+    else{                              //if not accessed
+      return current->vaddr;
+    }
+  }
+  panic("select_page_to_back: empty queue");
+}
+
+//SCFIFO without clearing accessed bits: the first page not accessed, or
+//the head once the hand went around
+static void*
+scfifo_peek(struct proc *p){
+  struct page_queue *pq=&p->paging_meta.pq;
+  struct page *pg, *head = 0;
+  pte_t *e;
+  int i;
+
+  for(i = 0; i<pq->count; i++){
+    if((pg = queued_page(p,PQ_POS(pq,i))) == 0)
+      continue;
+    e = pgpte(p,pg->vaddr);
+    if(!(*e & PTE_A))
+      return pg->vaddr;
+    if(head == 0)
+      head = pg;
+  }
+  if(head == 0)
+    panic("select_page_to_back: empty queue");
+  return head->vaddr;
+}
+
+//AQ: the page at the head of the queue
+static void*
+aq_select(struct proc *p){
+  struct page *toReturn;
+
+  if((toReturn = dequeue(p)) == 0)
+    panic("select_page_to_back: empty queue");
+  return toReturn->vaddr;
+}
+
+static void*
+aq_peek(struct proc *p){
+  struct page_queue *pq=&p->paging_meta.pq;
+  struct page *pg;
+  int i;
+
+  for(i = 0; i<pq->count; i++)
+    if((pg = queued_page(p,PQ_POS(pq,i))) != 0)
+      return pg->vaddr;
+  panic("select_page_to_back: empty queue");
+}
+
+//AQ: after an aging pass, move each accessed page one place towards the tail
+static void
+aq_age(struct proc *p){
+  struct page_queue *pq=&p->paging_meta.pq;
+  struct page *pg, *pg_next;
+  int j;
+
+  //start from the second place from last.
+  for(j = pq->count - 2; j>=0; j--){
+    int pos      = PQ_POS(pq,j);
+    int pos_next = PQ_POS(pq,j+1);
+    if((pg = queued_page(p,pos)) == 0 || (pg_next = queued_page(p,pos_next)) == 0)
+      continue;
+    //if the j'th page was accessed, and the j+1 not, switch them.
+    if(pg->acc && !pg_next->acc){
+      int vpn = pq->slots[pos];
+      uint seq = pg->qseq;
+      pq->slots[pos]      = pq->slots[pos_next];
+      pq->slots[pos_next] = vpn;
+      pg_next->qslot = pos;
+      pg->qslot      = pos_next;
+      pg->qseq       = pg_next->qseq;     //the queue order, for NFUA and LAPA
+      pg_next->qseq  = seq;
+    }
+  }
+}
+
+//1 if pg of p was accessed since a clock hand last took its reference
+static int
+take_ref(struct proc *p, struct page *pg){
+  pte_t *e = pgpte(p,pg->vaddr);
+  int refd = pg->refd;                  //seen by the ager meanwhile
+
+  pg->refd = 0;
+  if(e && (*e & PTE_A)){
+    ra_account(pg,*e,0);
+    *e &= ~PTE_A;
+    tlb_flush_page(p->pgdir,pg->vaddr);
+    refd = 1;
+  }
+  return refd;
+}
+
+//WSCLOCK: the ager saw pg used
+static void
+ws_access(struct proc *p, struct page *pg){
+  pg->refd = 1;
+  pg->last = p->vticks;
+}
+
+static void
+ws_page_in(struct proc *p, struct page *pg){
+  pg->last = p->vticks;
+}
+
+// WSClock: the hand goes once around the pages in RAM.  A page used in
+// the last WS_TAU ticks of p's run time is in the working set and stays.
+// Of the older ones, the first clean page (still in swap, see out_slot)
+// is taken, since paging it out costs no write; else the first dirty
+// one, else the least recently used page.
+static void*
+ws_select(struct proc *p){
+  struct page *pg, *dirty = 0, *lru = 0;
+  pte_t *e;
+  int i, n = numOfPagedIn(p);
+
+  for(i = 0; i < n; i++){
+    if((pg = dequeue(p)) == 0)
+      break;
+    enqueue(p,pg);                     //paging out takes it off the queue
+    if(take_ref(p,pg))
+      pg->last = p->vticks;
+    else if(p->vticks - pg->last > WS_TAU){
+      e = pgpte(p,pg->vaddr);
+      if(pg->slot >= 0 && !(*e & PTE_D))
+        return pg->vaddr;
+      if(dirty == 0)
+        dirty = pg;
+    }
+    if(lru == 0 || p->vticks - pg->last > p->vticks - lru->last)
+      lru = pg;
+  }
+  if(dirty)
+    return dirty->vaddr;
+  if(lru == 0)
+    panic("select_page_to_back: empty queue");
+  return lru->vaddr;
+}
+
+// CLOCK-Pro: the pages in RAM are hot or cold, and only cold pages are paged
+// out.  A cold page's test period starts when it's faulted in, and it stays
+// a ghost when paged out within it.  A ghost faulted in again less than
+// ram_quota pages after its test period began - the evictions since, plus
+// the hot pages in use that were hit meanwhile - would have stayed with more
+// room for cold pages: it comes in hot and the cold target grows.  A ghost
+// faulted in later than that shrinks it.  But while the hot pages don't
+// fill the room the cold target leaves them, a page faulted in comes in hot.
+static void
+cp_access(struct proc *p, struct page *pg){
+  if(pg->arrival)
+    pg->arrival = 0;
+  else
+    pg->refd = 1;
+}
+
+//the hands: 1 if pg was referenced since the last look.  the access that
+//faulted pg in (which the retried instruction makes after page_in) is no
+//reference: else every page of a one-pass scan would turn hot.
+static int
+cp_ref(struct proc *p, struct page *pg){
+  if(!take_ref(p,pg))
+    return 0;
+  if(pg->arrival){
+    pg->arrival = 0;
+    return 0;
+  }
+  return 1;
+}
+
+//the number of hot pages in RAM; recent - only those the ager saw used lately
+static int
+cp_nhot(struct proc *p, int recent){
+  struct p_meta *meta = &p->paging_meta;
+  struct page *pg;
+  int i, nhot = 0;
+
+  for(i = 0; i < meta->pq.count; i++)
+    if((pg = queued_page(p,PQ_POS(&meta->pq,i))) != 0 && pg->hot)
+      if(!recent || (pg->age & CP_RECENT))
+        nhot++;
+  return nhot;
+}
+
+static void
+cp_page_in(struct proc *p, struct page *pg){
+  struct p_meta *meta = &p->paging_meta;
+  int quota = ram_quota(p);
+
+  pg->refd = 0;
+  pg->arrival = 1;
+  if(cp_nhot(p,0) < quota - meta->cold_target){
+    pg->hot  = 1;
+    pg->test = 0;
+    return;
+  }
+  if(pg->test && meta->nevict - pg->ntest + cp_nhot(p,1) <= quota){
+    pg->hot  = 1;
+    pg->test = 0;
+    if(meta->cold_target < quota - 1)
+      meta->cold_target++;
+    return;
+  }
+  if(pg->test && meta->cold_target > CP_MIN_COLD)
+    meta->cold_target--;
+  pg->hot   = 0;
+  pg->test  = 1;
+  pg->ntest = meta->nevict;
+}
+
+static void
+cp_page_out(struct proc *p, struct page *pg){
+  p->paging_meta.nevict++;
+}
+
+//the hot hand: turn unreferenced hot pages cold, until the hot pages fit in
+//the room the cold target leaves them.  cold pages are left to the cold hand.
+static void
+cp_hot_hand(struct proc *p){
+  struct p_meta *meta = &p->paging_meta;
+  struct page *pg;
+  int i, n = numOfPagedIn(p), nhot = cp_nhot(p,0);
+
+  for(i = 0; i < 2*n && nhot > ram_quota(p) - meta->cold_target; i++){
+    if((pg = dequeue(p)) == 0)
+      break;
+    enqueue(p,pg);
+    if(pg->hot && !cp_ref(p,pg)){
+      pg->hot  = 0;
+      pg->test = 0;
+      nhot--;
+    }
+  }
+}
+
+//the cold hand: an unreferenced cold page is paged out.  a referenced cold
+//page in its test period turns hot, one out of it starts a new test period.
+static void*
+cp_select(struct proc *p){
+  struct page *pg;
+  int i, n = numOfPagedIn(p);
+
+  cp_hot_hand(p);
+  for(i = 0; i < 2*n + 1; i++){
+    if((pg = dequeue(p)) == 0)
+      panic("select_page_to_back: empty queue");
+    enqueue(p,pg);                     //paging out takes it off the queue
+    if(pg->hot)
+      continue;
+    if(!cp_ref(p,pg))
+      return pg->vaddr;
+    if(pg->test){
+      pg->hot  = 1;
+      pg->test = 0;
+    }
+    else{
+      pg->test  = 1;
+      pg->ntest = p->paging_meta.nevict;
+    }
+  }
+  //every page is hot and referenced - take the one at the hand
+  if((pg = dequeue(p)) == 0)
+    panic("select_page_to_back: empty queue");
+  enqueue(p,pg);
+  pg->hot = 0;
+  return pg->vaddr;
+}
+
+//the first NADAPT policies are the candidates of ADAPT, which is not a
+//policy of its own but switches between them.
+enum { P_NFUA, P_LAPA, P_SCFIFO, P_AQ, P_WSCLOCK, P_CLOCKPRO, P_ADAPT };
+
+//NFUA and LAPA only look at the pages, their select is their peek
+static struct pg_policy policies[] = {
+[P_NFUA]      { "NFUA",     nfua_select,    nfua_select },
+[P_LAPA]      { "LAPA",     lapa_select,    lapa_select },
+[P_SCFIFO]    { "SCFIFO",   scfifo_select,  scfifo_peek },
+[P_AQ]        { "AQ",       aq_select,      aq_peek,  0,  aq_age },
+[P_WSCLOCK]   { "WSCLOCK",  ws_select,      0,  ws_access,  0,  ws_page_in },
+[P_CLOCKPRO]  { "CLOCKPRO", cp_select,      0,  cp_access,  0,  cp_page_in,  cp_page_out },
+};
+
+#if defined(NFUA)
+int pg_policy = P_NFUA;
+#elif defined(LAPA)
+int pg_policy = P_LAPA;
+#elif defined(SCFIFO)
+int pg_policy = P_SCFIFO;
+#elif defined(AQ)
+int pg_policy = P_AQ;
+#elif defined(WSCLOCK)
+int pg_policy = P_WSCLOCK;
+#elif defined(CLOCKPRO)
+int pg_policy = P_CLOCKPRO;
+#else
+int pg_policy = -1;                     //GLOBAL: one clock for all, see global_evict
+#endif
+
+//the replacement policy of p, 0 if none
+static struct pg_policy*
+pol(struct proc *p){
+  if(p->policy < 0 || p->policy >= NELEM(policies))
+    return 0;
+  return &policies[p->policy];
+}
+
+//the number of the policy called name (P_ADAPT for ADAPT), -1 if there's
+//none.  there's none under GLOBAL.
+int
+find_policy(char *name){
+  int i;
+
+  if(pg_policy < 0)
+    return -1;
+  for(i = 0; i < NELEM(policies); i++)
+    if(strncmp(name,policies[i].name,16) == 0)
+      return i;
+  if(strncmp(name,"ADAPT",16) == 0)
+    return P_ADAPT;
+  return -1;
+}
+
+//switch p to policy #policy.  ADAPT starts from NFUA, unless p is adaptive
+//already.  the caller holds p's paging lock, or p is new.
+void
+policy_set(struct proc *p, int policy){
+  if(policy != P_ADAPT){
+    p->adapt = 0;
+    p->policy = policy;
+  }
+  else if(!p->adapt){
+    p->adapt = 1;
+    p->policy = P_NFUA;
+  }
+}
+
+
+char*
+policy_name(int policy){
+  if(policy < 0 || policy >= NELEM(policies))
+    return "-";
+  return policies[policy].name;
+}
+
+// Adaptive policy selection (ADAPT), after LeCaR.  Every eviction also asks
+// the other candidates which page they would have taken, into their ghost
+// lists.  A fault on a page in a candidate's ghost list - or an access to
+// one the live policy kept in RAM - is a fault the candidate would have
+// taken.  Once a candidate missed ADAPT_MARGIN fewer of the last
+// ADAPT_WINDOW faults than the live policy, it becomes the live one.  The
+// candidates are simulated on the RAM contents of the live policy, not
+// their own: it's cheap, and close enough to rank them.
+
+//remember page vaddr in candidate k's ghost list
+static void
+ghost_add(struct adapt *ad, int k, void *vaddr){
+  int vpn = ((uint)vaddr >> PGSHIFT) + 1;
+  int i;
+
+  for(i = 0; i < ADAPT_GHOSTS; i++)
+    if(ad->ghost[k][i] == vpn)
+      return;
+  ad->ghost[k][ad->gnext[k]] = vpn;
+  ad->gnext[k] = (ad->gnext[k] + 1) % ADAPT_GHOSTS;
+}
+
+//record the victims the candidates other than the live one would take now
+static void
+adapt_evict(struct proc *p){
+  int k;
+
+  for(k = 0; k < NADAPT; k++)
+    if(k != p->policy && policies[k].peek)
+      ghost_add(&p->paging_meta.ad,k,policies[k].peek(p));
+}
+
+//the candidates that would have faulted on page vaddr: it faulted (fault),
+//or the ager found it accessed.  slides the window over the faults and
+//switches p to the candidate that missed the fewest of them.
+static void
+adapt_miss(struct proc *p, void *vaddr, int fault){
+  struct adapt *ad = &p->paging_meta.ad;
+  int vpn = ((uint)vaddr >> PGSHIFT) + 1;
+  int i, k, best = p->policy;
+  uchar mask = 0, *m;
+
+  for(k = 0; k < NADAPT; k++){
+    if(!fault && k == p->policy)        //read ahead - not a fault of the live one
+      continue;
+    for(i = 0; i < ADAPT_GHOSTS; i++)
+      if(ad->ghost[k][i] == vpn){
+        ad->ghost[k][i] = 0;            //back in RAM, as far as k knows
+        mask |= 1 << k;
+        break;
+      }
+  }
+  if(!fault && mask == 0)
+    return;
+  m = &ad->missed[ad->nfaults % ADAPT_WINDOW];
+  for(k = 0; k < NADAPT; k++)
+    ad->misses[k] += ((mask >> k) & 1) - ((*m >> k) & 1);   //the oldest fault leaves
+  *m = mask;
+  if(++ad->nfaults < ADAPT_WINDOW)
+    return;
+  for(k = 0; k < NADAPT; k++)
+    if(ad->misses[k] < ad->misses[best])
+      best = k;
+  if(ad->misses[best] + ADAPT_MARGIN <= ad->misses[p->policy]){
+    p->policy = best;
+    ad->switches++;
+  }
+}
+
+//print the switches and the misses of the candidates of p (procdump)
+void
+adaptdump(struct proc *p){
+  struct adapt *ad = &p->paging_meta.ad;
+  int k;
+
+  cprintf("  adapt: %d switches, misses in the last %d faults:",ad->switches,
+          ad->nfaults < ADAPT_WINDOW ? ad->nfaults : ADAPT_WINDOW);
+  for(k = 0; k < NADAPT; k++)
+    cprintf(" %s %d",policies[k].name,ad->misses[k]);
+  cprintf("\n");
+}
+
+//1 if pg of p is advised MADV_SEQUENTIAL, was used (not just read ahead),
+//and lies below the page the stream last faulted on - it moved past pg.
+int
+seq_passed(struct proc *p, struct page *pg){
+  return pg->advice == MADV_SEQUENTIAL && !pg->ra &&
+         (uint)pg->vaddr < p->paging_meta.seq_pos;
+}
+
+//evict behind: the first queued page the stream has moved past, 0 if none.
+static void*
+seq_behind(struct proc *p){
+  struct page_queue *pq=&p->paging_meta.pq;
+  struct page *pg;
+  int i;
+
+  for(i = 0; i<pq->count; i++){
+    if((pg = queued_page(p,PQ_POS(pq,i))) == 0)
+      continue;
+    if(seq_passed(p,pg))
+      return pg->vaddr;
+  }
+  return 0;
+}
+
+// Returns a Virtual Address of a page to be replaced in the RAM, by p's policy.
+// Pages behind a sequential stream (see madvise) go first.
+void*
+select_page_to_back(struct proc *p){
+  struct pg_policy *pp = pol(p);
+  void *vaddr = 0;
+
+  uint looks;
+
+  if(pp == 0)
+    panic("select_page_to_back: no policy");     //see global_evict
+  looks = p->paging_meta.pq.looks;
+  if(p->paging_meta.seq_advice)
+    vaddr = seq_behind(p);
+  if(vaddr == 0){
+    if(p->adapt)
+      adapt_evict(p);
+    vaddr = pp->select(p);
+    if(p->adapt)
+      ghost_add(&p->paging_meta.ad,p->policy,vaddr);
+  }
+  p->pgc.scans++;
+  p->pgc.scanned += p->paging_meta.pq.looks - looks;
+  return vaddr;
+}
+
+//the number of pages p may keep in RAM - MAX_PSYC_PAGES, unless the PFF
+//controller (see pff_update) changed it.
+int
+ram_quota(struct proc *p){
+  return p->paging_meta.frames ? p->paging_meta.frames : MAX_PSYC_PAGES;
+}
+
+// Adds the meta-data of a TOTALLY new page pg at vaddr, resident.
+// returns 0 if out of memory for the queue.
+int
+page_new_meta(struct proc *p, struct page *pg, void *vaddr){
+  struct p_meta *meta = &p->paging_meta;
+
+  pg->exists  = 1;
+  pg->vaddr   = vaddr;
+  pg->in_back = 0;
+  pg->age     = 0;
+  pg->age2    = 0xffffffff;
+  pg->ra      = 0;
+  pg->qslot   = -1;
+  pg->slot    = -1;
+  pg->last    = p->vticks;
+  pg->test    = 1;                  //CLOCKPRO: a new page starts cold, in its test period
+  pg->ntest   = meta->nevict;
+  pg->arrival = 1;                  //CLOCKPRO: its first touch is no reference (see cp_ref)
+  if(meta->cold_target == 0)
+    meta->cold_target = CP_COLD_INIT;
+  if(!enqueue(p,pg)){
+    pg->exists = 0;
+    return 0;
+  }
+  meta->num_in_ram++;
+  return 1;
+}
+
+//update page meta-data when going to front
+int
+page_in_meta(struct proc* p,void* vaddr){
+  struct p_meta *meta  =   &p->paging_meta;
+  struct page *pg      =   find_page(p,vaddr);
+  if(pg == 0)
+    return 0;
+  if(pol(p) && pol(p)->page_in)
+    pol(p)->page_in(p,pg);
+  pg->in_back =   0;                       //mark as "NOT Backed"
+  pg->ra      =   0;
+  pg->refd    =   0;
+  pg->age     =   0;                       //reset age
+  pg->age2    =   0xffffffff;
+  meta->num_in_back--;
+  meta->num_in_ram++;
+  return enqueue(p,pg);                    //enqueue after paging in .
+}
+
+//adds a page to the meta data of the Process (when a page is added to the back)
+//page needs to already exist in the list.
+int
+page_out_meta(struct proc *p,void* vaddr){
+  struct p_meta *meta  =   &p->paging_meta;
+  struct page *pg      =   find_page(p,vaddr);
+  if(pg == 0)
+    return 0;
+  if(pol(p) && pol(p)->page_out)
+    pol(p)->page_out(p,pg);
+  pg->in_back =   1;                     //mark as "Backed"
+  free_from_queue(p,pg);                 //no longer in RAM
+  meta->num_in_ram--;
+  meta->num_in_back++;
+  return 1;
+}
+
+//Aging
+//shift the accessed bit of resident page pg into its ages.  acc - the page
+//was accessed in the last interval (its accessed bit is already cleared).
+void
+age_page(struct proc *p, struct page *pg, int acc){
+  struct pg_policy *pp = pol(p);
+
+  if(acc){
+    if(pp && pp->access)
+      pp->access(p,pg);
+    if(p->adapt)
+      adapt_miss(p,pg->vaddr,0);
+  }
+  //the ages are kept whatever the policy, so it can change any time
+  pg->acc  = acc != 0;
+  pg->age  = (pg->age >> 1) | (acc ? MSB : 0);    //shift right, MSB if accessed
+  pg->age2 = (pg->age2 >> 1) | (acc ? MSB : 0);   //for LAPA
+}
+
+//an aging pass over p's pages is done
+void
+policy_aged(struct proc *p){
+  struct pg_policy *pp = pol(p);
+  int h;
+
+  if(pp && pp->age)
+    pp->age(p);
+  for(h = 0; h < NHEAP; h++)
+    p->paging_meta.heap[h].valid = 0;   //the keys changed
+}
+
+//p faults on its paged out page at vaddr
+void
+policy_fault(struct proc *p, void *vaddr){
+  p->paging_meta.pff_faults++;
+  if(p->adapt)
+    adapt_miss(p,vaddr,1);
+}
+#endif
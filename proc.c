@@ -4,6 +4,7 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "x86.h"
+#include "pgstat.h"
 #include "proc.h"
 #include "spinlock.h"
 
@@ -28,6 +29,66 @@ int is_user_proc(struct proc* p){
   return 0;
 }
 
+// Paging counters of the processes that were reaped.
+static struct pgcount pgc_gone;
+
+// Add the counters of src to dst.  struct pgcount holds only uints.
+static void
+pgcount_add(struct pgcount *dst, struct pgcount *src)
+{
+  uint *d = (uint*)dst, *s = (uint*)src;
+  int i;
+
+  for(i = 0; i < sizeof(*dst)/sizeof(uint); i++)
+    d[i] += s[i];
+}
+
+// The paging lock of a process is held while its paging meta-data and
+// swapped page table entries change - by the process itself, or by another
+// process that takes its pages (GLOBAL replacement).
+void
+pglock(struct proc *p){
+  acquire(&ptable.lock);
+  while(p->pgholder)
+    sleep(&p->pgholder, &ptable.lock);
+  p->pgholder = myproc();
+  release(&ptable.lock);
+}
+
+// Take the paging lock of another process that is not running, and keep it
+// off the CPUs until pgthaw, so its mappings can be changed without a TLB
+// flush.  Returns 0 if p is running, exiting or busy.
+int
+pgtrylock(struct proc *p){
+  int ok;
+
+  acquire(&ptable.lock);
+  ok = (p->state == SLEEPING || p->state == RUNNABLE) && is_user_proc(p) &&
+       p->pgholder == 0;
+  if(ok){
+    p->pgholder = myproc();
+    p->pgfrozen = 1;
+  }
+  release(&ptable.lock);
+  return ok;
+}
+
+void
+pgthaw(struct proc *p){
+  acquire(&ptable.lock);
+  p->pgfrozen = 0;
+  release(&ptable.lock);
+}
+
+void
+pgunlock(struct proc *p){
+  acquire(&ptable.lock);
+  p->pgholder = 0;
+  p->pgfrozen = 0;
+  wakeup1(&p->pgholder);
+  release(&ptable.lock);
+}
+
 void
 pinit(void)
 {
@@ -77,9 +138,10 @@ myproc(void) {
 // Look in the process table for an UNUSED proc.
 // If found, change state to EMBRYO and initialize
 // state required to run in the kernel.
+// Kernel threads get pid 0, so they are never user processes.
 // Otherwise return 0.
 static struct proc*
-allocproc(void)
+allocproc(int kernel)
 {
   struct proc *p;
   char *sp;
@@ -95,7 +157,16 @@ allocproc(void)
 
 found:
   p->state = EMBRYO;
-  p->pid = nextpid++;
+  p->pid = kernel ? 0 : nextpid++;
+  p->pgholder = 0;
+  p->pgfrozen = 0;
+  p->vticks = 0;
+  memset(&p->pgc, 0, sizeof(p->pgc));
+  memset(&p->cpgc, 0, sizeof(p->cpgc));
+#ifndef NONE
+  p->adapt = 0;
+  policy_set(p, pg_policy);
+#endif
 
   release(&ptable.lock);
 
@@ -130,7 +201,7 @@ userinit(void)
 {
   struct proc *p;
   extern char _binary_initcode_start[], _binary_initcode_size[];
-  p = allocproc();
+  p = allocproc(0);
   
   initproc = p;
   if((p->pgdir = setupkvm()) == 0)
@@ -145,8 +216,6 @@ userinit(void)
   p->tf->eflags = FL_IF;
   p->tf->esp = PGSIZE;
   p->tf->eip = 0;  // beginning of initcode.S
-  p->page_faults = 0;
-  p->num_pageouts = 0;
 
   safestrcpy(p->name, "initcode", sizeof(p->name));
   p->cwd = namei("/");
@@ -171,17 +240,47 @@ growproc(int n)
   struct proc *curproc = myproc();
   sz = curproc->sz;
   if(n > 0){
-    if((sz = allocuvm(curproc->pgdir, sz, sz + n)) == 0)
+    //pages are allocated on first touch (see page_fault)
+    if(sz + n >= KERNBASE || sz + n < sz)
       return -1;
+    sz += n;
   } else if(n < 0){
-    if((sz = deallocuvm(curproc->pgdir, sz, sz + n)) == 0)
+    pglock(curproc);
+    sz = deallocuvm(curproc->pgdir, sz, sz + n);
+    pgunlock(curproc);
+    if(sz == 0)
       return -1;
   }
-  curproc->sz = sz;
-  switchuvm(curproc);
+  curproc->sz = sz;                     //deallocuvm flushed the TLB
   return 0;
 }
 
+// Start a kernel thread that runs fn in the kernel, with no user memory.
+// fn must never return.
+void
+kthread(char *name, void (*fn)(void))
+{
+  struct proc *p;
+
+  if((p = allocproc(1)) == 0 || (p->pgdir = setupkvm()) == 0)
+    panic("kthread: out of memory?");
+  p->sz = 0;
+  safestrcpy(p->name, name, sizeof(p->name));
+  // forkret returns to fn instead of trapret.
+  *(uint*)((char*)p->context + sizeof(*p->context)) = (uint)fn;
+
+  acquire(&ptable.lock);
+  p->state = RUNNABLE;
+  release(&ptable.lock);
+}
+
+// The process table slot #i, for scans outside proc.c.
+struct proc*
+procslot(int i)
+{
+  return &ptable.proc[i];
+}
+
 // Create a new process copying p as the parent.
 // Sets up stack to return as if from system call.
 // Caller must set state of returned proc to RUNNABLE.
@@ -193,7 +292,7 @@ fork(void)
   struct proc *curproc = myproc();
 
   // Allocate process.
-  if((np = allocproc()) == 0){
+  if((np = allocproc(0)) == 0){
     return -1;
   }
 
@@ -204,6 +303,22 @@ fork(void)
     np->state = UNUSED;
     return -1;
   }
+  #ifndef NONE
+  //copy the paging meta-data - if the parent is a user process.
+  //swapped out pages and frames are shared with the parent (see copyuvm)
+  if(is_user_proc(curproc)){
+    pglock(curproc);
+    i = copy_paging_meta(np,curproc);
+    pgunlock(curproc);
+    if(!i){
+      freevm(np->pgdir);
+      kfree(np->kstack);
+      np->kstack = 0;
+      np->state = UNUSED;
+      return -1;
+    }
+  }
+  #endif
   np->sz = curproc->sz;
   np->parent = curproc;
   *np->tf = *curproc->tf;
@@ -216,6 +331,9 @@ fork(void)
     if(curproc->ofile[i])
       np->ofile[i] = filedup(curproc->ofile[i]);
   np->cwd = idup(curproc->cwd);
+  np->image = curproc->image ? idup(curproc->image) : 0;
+  memmove(np->seg, curproc->seg, sizeof(np->seg));
+  np->nseg = curproc->nseg;
 
   safestrcpy(np->name, curproc->name, sizeof(curproc->name));
 
@@ -223,20 +341,12 @@ fork(void)
 
   
   #ifndef NONE
-  if(is_user_proc(np)){
-    if(createSwapFile(np) != 0){
-      panic("fork_create swapfile");
-    }
-  }
-  //copy from parent - if he's a user process OR the shell
-  if(is_user_proc(curproc)){
-  //initialize swap file meta
-    copy_parent_swapfile(np,curproc);
-  }
   // if(is_user_proc(np))
   //   np->paging_meta=curproc->paging_meta;
   np->page_faults = 0;    //reset number of page faults to 0;
-  np->num_pageouts = 0;
+  np->vticks = curproc->vticks;   //the copied page use times are in the parent's time
+  np->policy = curproc->policy;
+  np->adapt = curproc->adapt;
   #endif
 
   acquire(&ptable.lock);
@@ -264,9 +374,9 @@ exit(void)
   #ifndef NONE
   //if the process is not init or shell
   if(is_user_proc(curproc)){
-     if(removeSwapFile(curproc)!=0)
-      panic("remove_swap_file");
-      reset_paging_meta(curproc);
+    pglock(curproc);
+    reset_paging_meta(curproc);
+    pgunlock(curproc);
 
   }
   #endif
@@ -281,8 +391,11 @@ exit(void)
 
   begin_op();
   iput(curproc->cwd);
+  if(curproc->image)
+    iput(curproc->image);
   end_op();
   curproc->cwd = 0;
+  curproc->image = 0;
   
   #if  TRUE
   procdump();
@@ -327,6 +440,9 @@ wait(void)
       if(p->state == ZOMBIE){
         // Found one.
         pid = p->pid;
+        pgcount_add(&pgc_gone, &p->pgc);
+        pgcount_add(&curproc->cpgc, &p->pgc);
+        pgcount_add(&curproc->cpgc, &p->cpgc);
         kfree(p->kstack);
         p->kstack = 0;
         freevm(p->pgdir);
@@ -373,7 +489,7 @@ scheduler(void)
     // Loop over process table looking for process to run.
     acquire(&ptable.lock);
     for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->state != RUNNABLE)
+      if(p->state != RUNNABLE || p->pgfrozen)
         continue;
 
       // Switch to chosen process.  It is the process's job
@@ -536,6 +652,70 @@ kill(int pid)
   return -1;
 }
 
+#ifndef NONE
+// Switch process pid to page replacement policy #policy, or every user
+// process and the ones created from now on if pid is 0.
+// Returns -1 if there is no such process.
+int
+setpolicy(int pid, int policy)
+{
+  struct proc *p;
+  int found = 0;
+
+  if(pid == 0)
+    pg_policy = policy;
+  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+    acquire(&ptable.lock);
+    if(p->state == UNUSED || !is_user_proc(p) || (pid != 0 && p->pid != pid)){
+      release(&ptable.lock);
+      continue;
+    }
+    release(&ptable.lock);
+    //not in the middle of paging - the policy's state stays consistent
+    pglock(p);
+    if(is_user_proc(p) && (pid == 0 || p->pid == pid)){
+      policy_set(p, policy);
+      found = 1;
+    }
+    pgunlock(p);
+  }
+  return pid == 0 || found ? 0 : -1;
+}
+#endif
+
+// Fill st with the paging counters of process pid and of the children it
+// reaped, or if pid is 0, with the sum over all processes, live and
+// reaped, and the system-wide ones.
+// Returns -1 if there is no such process.
+int
+getpgstat(int pid, struct pgstat *st)
+{
+  struct proc *p;
+  int found = pid == 0;
+
+  memset(st, 0, sizeof(*st));
+  acquire(&ptable.lock);
+  if(pid == 0)
+    pgcount_add(&st->c, &pgc_gone);
+  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
+    if(p->state != UNUSED && (pid == 0 || p->pid == pid)){
+      pgcount_add(&st->c, &p->pgc);
+      if(pid != 0)
+        pgcount_add(&st->cc, &p->cpgc);
+      #ifndef NONE
+      if(pid != 0 && is_user_proc(p)){
+        st->frames = ram_quota(p);
+        st->pff_rate = p->paging_meta.pff_rate;
+      }
+      #endif
+      found = 1;
+    }
+  release(&ptable.lock);
+  if(pid == 0)
+    pgstat_sys(st);
+  return found ? 0 : -1;
+}
+
 //PAGEBREAK: 36
 // Print a process listing to console.  For debugging.
 // Runs when user types ^P on console.
@@ -568,8 +748,12 @@ procdump(void)
     int current_allocated=get_allocated_pages(p);
     int paged_out=numOfPagedOut(p);
     int page_faults=p->page_faults;
-    int total_out=p->num_pageouts;
+    int total_out=p->pgc.pages_out;
     cprintf(" %d %d %d %d",current_allocated,paged_out,page_faults,total_out);
+    if(is_user_proc(p))
+      cprintf(" %s%s %d pinned, %d frames, %d faults/window",p->adapt ? "ADAPT/" : "",
+              policy_name(p->policy),p->paging_meta.num_pinned,ram_quota(p),
+              p->paging_meta.pff_rate);
     #endif
 
     
@@ -579,12 +763,23 @@ procdump(void)
         cprintf(" %p", pc[i]);
     }
     cprintf("\n");
+    #ifndef NONE
+    if(is_user_proc(p) && p->adapt)
+      adaptdump(p);
+    #endif
   }
   //now print ratio
   #ifndef NONE
   int free_pages=num_free();
   int used_kernel=initial_pages_num(); //TODO: Check correctness
   cprintf("%d  /  %d  free pages in the system\n",free_pages,free_pages + used_kernel);
+  cprintf("readahead window %d: %d read, %d hits, %d misses\n",ra_window,ra_reads,ra_hits,ra_misses);
+  cprintf("zero pages: %d paged out, %d mapped in\n",zero_outs,zero_ins);
+  cprintf("clean pages: %d paged out without a write\n",clean_outs);
+  swapdump();
+#ifdef KSM
+  cprintf("ksm: %d pages scanned, %d merged, %d frames saved\n",ksm_scanned,ksm_merged,merged_savings());
+#endif
   #endif
 
 }
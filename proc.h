@@ -39,32 +39,92 @@ enum procstate {
 
 
 
+//the swap slot of a page in back is kept in its page table entry (see PTE_SLOT).
+//the flags are bits so that PMETA_LEAF records fit in one page (see page_lookup).
 struct page{
-    int         exists;         //1 -if this page exists, 0 if it's the end of the list.
     void*       vaddr;          //the page's virtual address
-    int         in_back;        //1 if in back, 0 if stored in the memory.
-    uint        offset;         //offset in Back file ( if in_back == 1 )
     uint        age;            //for NFUA
     uint        age2;           //for LAPA
+    int         qslot;          //position in the page queue, -1 if not queued
+    uint        sum;            //checksum at the last ksmd scan
+    uint        last;           //WSCLOCK: process time of the last use
+    uint        ntest;          //CLOCKPRO: eviction count when its test period began
+    int         slot;           //swap slot still holding the page while it's clean, -1 if none
+    int         advice;         //MADV_RANDOM or MADV_SEQUENTIAL if given by madvise, else 0
+    uint        qseq;           //order it was queued in: the first queued of equal keys goes first
+    ushort      hpos[NHEAP];    //position in each page heap, while it's built (see heap_get)
+    uint        exists  : 1;    //1 -if this page exists, 0 if it's the end of the list.
+    uint        in_back : 1;    //1 if in back, 0 if stored in the memory.
+    uint        ra      : 1;    //read ahead, not accessed yet
+    uint        acc     : 1;    //accessed in the last aging interval (AQ)
+    uint        refd    : 1;    //accessed since a clock hand last took it (WSCLOCK, CLOCKPRO)
+    uint        hot     : 1;    //CLOCKPRO: hot page
+    uint        test    : 1;    //CLOCKPRO: in its test period (a ghost, if paged out)
+    uint        arrival : 1;    //CLOCKPRO: the next reference seen is the access that faulted it in
+    uint        pinned  : 1;    //locked in RAM by mlock, and out of the page queue
+    uint        held    : 1;    //kept in RAM, out of the queue, for the running system call (see prefault)
 };
 
 
-//a page queue .
+//a page queue - a ring of virtual page numbers in one page, -1 marks a removed entry.
 struct page_queue {
-    struct page         pages[MAX_TOTAL_PAGES];
-    int lastIndex;
+    int         *slots;         //allocated on first use
+    int         head;           //position of the first (oldest) entry
+    int         count;          //number of positions in use, from head on
+    uint        looks;          //entries looked at (the scan length of select_page_to_back)
+    uint        seq;            //pages queued so far
+};
+
+//the queued pages in a binary heap by a policy's key (NFUA, LAPA), in one page.
+struct page_heap {
+    int         *slots;         //virtual page numbers, allocated on first use
+    int         count;
+    int         valid;          //built, and no aging pass changed the keys since
+};
+
+//adaptive policy selection (ADAPT): for each candidate policy, the pages it
+//would have paged out lately, and which candidates missed the last faults.
+struct adapt {
+    int         ghost[NADAPT][ADAPT_GHOSTS];   //rings of virtual page number + 1, 0 if empty
+    int         gnext[NADAPT];                 //next position to fill in each ring
+    uchar       missed[ADAPT_WINDOW];          //per fault, bit k set if candidate k missed it
+    uint        nfaults;                       //faults seen so far
+    int         misses[NADAPT];                //faults each candidate missed in the window
+    int         switches;                      //times the live policy was changed
 };
 
 struct p_meta {  
-    struct page         pages[MAX_TOTAL_PAGES];               //    contains virtual addresses. the i'th address means the i'th page
-    struct page_queue   pq;                                   //    used for SCFIFO
-    int                 offsets[MAX_TOTAL_PAGES];             //    0 if offset #i is available, 1 otherwise (taken by some page)
+    struct page         **dir[PMETA_NDIR];                    //    radix tree of page records, indexed by virtual page number (see page_lookup)
+    struct page_queue   pq;                                   //    pages in RAM, in queue order (SCFIFO, AQ, the clock hands)
+    struct page_heap    heap[NHEAP];                          //    the same pages by NFUA and LAPA's keys
+    int                 num_in_ram;                           //    number of pages stored in the memory
+    int                 num_in_back;                          //    number of pages in back
+    int                 num_pinned;                           //    number of pages pinned by mlock (at most MAX_PINNED)
+    int                 num_held;                             //    number of pages held for the running system call
+    uint                held_va, held_end;                    //    the range they were held in (see unhold)
+    int                 frames;                               //    PFF: pages allowed in RAM, 0 for MAX_PSYC_PAGES (see ram_quota)
+    uint                pff_faults;                           //    PFF: faults on paged out pages in this window
+    uint                pff_start;                            //    PFF: process time this window started
+    uint                pff_rate;                             //    PFF: faults in the last window
+    int                 cold_target;                          //    CLOCKPRO: pages in RAM kept for cold pages
+    uint                nevict;                               //    CLOCKPRO: pages paged out so far
+    struct adapt        ad;                                   //    ADAPT: simulated candidates
+    int                 seq_advice;                           //    some pages were advised MADV_SEQUENTIAL (see seq_behind)
+    uint                seq_pos;                              //    the last of them faulted on: the stream is there
 
 };
 
 
 
 
+// A loadable segment of the running program, paged in from its inode on demand.
+struct segment {
+    uint        vaddr;          //page aligned start
+    uint        memsz;          //size in memory, the part past filesz is zero (bss)
+    uint        off;            //offset of the segment in the program file
+    uint        filesz;         //bytes to read from the file
+};
+
 // Per-process state
 struct proc {
     uint sz;                     // Size of process memory (bytes)
@@ -80,12 +140,30 @@ struct proc {
     struct file *ofile[NOFILE];  // Open files
     struct inode *cwd;           // Current directory
     char name[16];               // Process name (debugging)
+    struct inode *image;         // Program file the segments are paged in from
+    struct segment seg[NSEG];    // Loadable segments of the program
+    int nseg;
     struct p_meta paging_meta;
-    //Swap file. must initiate with create swap file
-    struct file *swapFile;      //page file
     //added task 3
     uint    page_faults;
-    uint    num_pageouts;
+    struct pgcount pgc;         //paging counters (see getpgstat)
+    struct pgcount cpgc;        //and those of the children it reaped (see wait)
+    uint    vticks;             //ticks spent running (WSCLOCK's process time)
+    int     policy;             //page replacement policy (see policies in policy.c), -1 if none
+    int     adapt;              //1 if policy is switched to the best candidate (ADAPT)
+    struct proc *pgholder;      //process changing our paging meta-data, 0 if none (see pglock)
+    int     pgfrozen;           //kept off the CPUs while another process unmaps our pages
+};
+
+//a page replacement policy - the hooks other than select may be 0.
+struct pg_policy {
+    char        *name;
+    void*       (*select)(struct proc*);                  //the page to page out next
+    void*       (*peek)(struct proc*);                    //the page select would take, changing nothing
+    void        (*access)(struct proc*, struct page*);    //the ager found the page accessed
+    void        (*age)(struct proc*);                     //after each aging pass
+    void        (*page_in)(struct proc*, struct page*);   //the page is back in RAM
+    void        (*page_out)(struct proc*, struct page*);  //the page leaves RAM
 };
 
 
@@ -6,6 +6,7 @@
 #include "x86.h"
 #include "memlayout.h"
 #include "mmu.h"
+#include "pgstat.h"
 #include "proc.h"
 #include "spinlock.h"
 #include "sleeplock.h"
@@ -0,0 +1,386 @@
+// Swap space: page-sized slots shared by all processes.
+//
+// Slots live in a raw area of NSWAPPAGES pages on the root disk, right
+// after the file system (mkfs leaves room for it). Pages move between
+// memory and the area with one disk command per request, without the
+// log, the buffer cache or any inode.
+// Every slot has a reference count, so a forked child shares the paged out
+// pages of its parent until one of them pages its copy back in.
+//
+// With ZSWAP, a page written to a slot is first compressed into a pool
+// of up to ZPOOL_PAGES kernel frames, and only goes to the disk when it
+// does not compress well or the pool is full. Reading such a slot back
+// needs no disk I/O at all.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "fs.h"
+#include "spinlock.h"
+#include "pgstat.h"
+#include "sleeplock.h"
+
+#define NSWAPSLOTS NSWAPPAGES
+#define SLOTSECTOR(slot) (SWAPSTART*(BSIZE/512) + (slot)*(PGSIZE/512))
+
+// Pool frames are cut into chunks; a compressed page takes a run of
+// chunks in one frame. Chunk #c of the pool is chunk c%ZCHUNKS of
+// frame c/ZCHUNKS.
+#define ZCHUNK  64
+#define ZCHUNKS (PGSIZE/ZCHUNK)
+#define ZMAXLEN (PGSIZE - PGSIZE/4)   //pages that compress worse go to disk
+#define ZHASH   4096
+
+struct {
+  struct spinlock lock;
+  uchar ref[NSWAPSLOTS];        //number of page table entries holding slot #i
+  int nfree;                    //number of slots with ref 0
+  int next;                     //where to start looking for a free slot
+#ifdef ZSWAP
+  char *zframe[ZPOOL_PAGES];    //pool frames, 0 while unused
+  uchar zused[ZPOOL_PAGES][ZCHUNKS]; //1 if the chunk holds data
+  int zfill[ZPOOL_PAGES];       //chunks in use per frame
+  ushort zpos[NSWAPSLOTS];      //first chunk of slot #i in the pool
+  uchar zlen[NSWAPSLOTS];       //its number of chunks, 0 if it is on disk
+  int zchunks;                  //chunks in use
+  int zframes;                  //frames in the pool
+  uint zhits;                   //slot reads served by the pool
+  uint zmisses;                 //slot reads that went to disk
+  uint zstores;                 //pages compressed into the pool
+  uint zrejects;                //pages that did not compress well enough
+  uint zspills;                 //pages written to disk since the pool was full
+  uint zin, zout;               //bytes before and after compression
+#endif
+} swap;
+
+#ifdef ZSWAP
+// Compression state, one page at a time.
+struct {
+  struct sleeplock lock;
+  ushort hash[ZHASH];           //last position of a 3 byte sequence
+  uchar buf[ZMAXLEN];           //compressed page
+} zwork;
+#endif
+
+void
+swapinit(void)
+{
+  initlock(&swap.lock, "swap");
+#ifdef ZSWAP
+  initsleeplock(&zwork.lock, "zswap");
+#endif
+  swap.nfree = NSWAPSLOTS;
+}
+
+#ifdef ZSWAP
+// LZ77 in the style of LZRW1: a 16 bit control word, then 16 items,
+// each a literal byte (bit clear) or a 2 byte copy (bit set) of 3-18
+// bytes from up to 4095 bytes back.
+
+// Compress the page at src into dst, at most max bytes.
+// Returns the compressed length, or -1 if it does not fit.
+static int
+zcompress(uchar *src, uchar *dst, int max)
+{
+  uint i = 0, o = 2, ctl = 0, cpos = 0, bit = 0;
+  uint h, cand, off = 0, len;
+
+  memset(zwork.hash, 0xff, sizeof(zwork.hash));
+  while(i < PGSIZE){
+    if(bit == 16){
+      dst[cpos] = ctl;
+      dst[cpos+1] = ctl >> 8;
+      cpos = o;
+      o += 2;
+      ctl = bit = 0;
+    }
+    if(o + 2 > max)
+      return -1;
+    len = 0;
+    if(i + 3 <= PGSIZE){
+      h = ((src[i] << 4) ^ (src[i+1] << 2) ^ src[i+2] ^ (src[i] >> 4)) & (ZHASH-1);
+      cand = zwork.hash[h];
+      zwork.hash[h] = i;
+      if(cand != 0xffff){
+        off = i - cand;
+        while(len < 18 && i + len < PGSIZE && src[cand+len] == src[i+len])
+          len++;
+      }
+    }
+    if(len >= 3){
+      dst[o++] = ((len - 3) << 4) | (off >> 8);
+      dst[o++] = off;
+      ctl |= 1 << bit;
+      i += len;
+    } else
+      dst[o++] = src[i++];
+    bit++;
+  }
+  dst[cpos] = ctl;
+  dst[cpos+1] = ctl >> 8;
+  return o;
+}
+
+// Decompress a page made by zcompress from src into dst.
+static void
+zdecompress(uchar *src, uchar *dst)
+{
+  uint i = 0, o = 0, ctl = 0, bit = 16, len, off;
+
+  while(o < PGSIZE){
+    if(bit == 16){
+      ctl = src[i] | (src[i+1] << 8);
+      i += 2;
+      bit = 0;
+    }
+    if(ctl & (1 << bit)){
+      len = (src[i] >> 4) + 3;
+      off = ((src[i] & 0xf) << 8) | src[i+1];
+      i += 2;
+      for(; len > 0; len--, o++)
+        dst[o] = dst[o - off];
+    } else
+      dst[o++] = src[i++];
+    bit++;
+  }
+}
+
+// Mark n chunks from chunk pos used (or free), releasing frames that
+// become empty. Caller must hold swap.lock.
+static void
+zmark(int pos, int n, int used)
+{
+  int f = pos / ZCHUNKS, c;
+
+  for(c = pos % ZCHUNKS; n > 0; c++, n--){
+    swap.zused[f][c] = used;
+    swap.zfill[f] += used ? 1 : -1;
+    swap.zchunks += used ? 1 : -1;
+  }
+  if(swap.zfill[f] == 0){
+    kfree(swap.zframe[f]);
+    swap.zframe[f] = 0;
+    swap.zframes--;
+  }
+}
+
+// Find n free consecutive chunks, adding a frame to the pool if needed.
+// Returns the first chunk, or -1 if the pool is full.
+// Caller must hold swap.lock.
+static int
+zfit(int n)
+{
+  int f, c, run;
+
+  for(f = 0; f < ZPOOL_PAGES; f++){
+    if(swap.zframe[f] == 0 || ZCHUNKS - swap.zfill[f] < n)
+      continue;
+    for(c = run = 0; c < ZCHUNKS; c++){
+      run = swap.zused[f][c] ? 0 : run + 1;
+      if(run == n)
+        return f*ZCHUNKS + c + 1 - n;
+    }
+  }
+  for(f = 0; f < ZPOOL_PAGES; f++){
+    if(swap.zframe[f] == 0){
+      if((swap.zframe[f] = kalloc()) == 0)
+        return -1;
+      swap.zframes++;
+      return f*ZCHUNKS;
+    }
+  }
+  return -1;
+}
+
+// Compress the page at mem into the pool as slot.
+// Returns 0 on success, -1 if it has to go to disk.
+static int
+zstore(uint slot, char *mem)
+{
+  int n, pos, r = -1;
+
+  acquiresleep(&zwork.lock);
+  n = zcompress((uchar*)mem, zwork.buf, ZMAXLEN);
+  acquire(&swap.lock);
+  if(n < 0)
+    swap.zrejects++;
+  else if((pos = zfit((n + ZCHUNK - 1) / ZCHUNK)) < 0)
+    swap.zspills++;
+  else {
+    swap.zpos[slot] = pos;
+    swap.zlen[slot] = (n + ZCHUNK - 1) / ZCHUNK;
+    zmark(pos, swap.zlen[slot], 1);
+    memmove(swap.zframe[pos/ZCHUNKS] + (pos%ZCHUNKS)*ZCHUNK, zwork.buf, n);
+    swap.zstores++;
+    swap.zin += PGSIZE;
+    swap.zout += n;
+    r = 0;
+  }
+  release(&swap.lock);
+  releasesleep(&zwork.lock);
+  return r;
+}
+
+// Decompress slot from the pool into the page at mem.
+// Returns -1 if the slot is on disk.
+// The data can't move while the caller holds a reference to slot.
+static int
+zload(uint slot, char *mem)
+{
+  char *src;
+
+  acquire(&swap.lock);
+  if(swap.zlen[slot] == 0){
+    swap.zmisses++;
+    release(&swap.lock);
+    return -1;
+  }
+  swap.zhits++;
+  src = swap.zframe[swap.zpos[slot]/ZCHUNKS] + (swap.zpos[slot]%ZCHUNKS)*ZCHUNK;
+  release(&swap.lock);
+  zdecompress((uchar*)src, (uchar*)mem);
+  return 0;
+}
+
+// Forget the pool copy of a slot. Caller must hold swap.lock.
+static void
+zdrop(uint slot)
+{
+  if(swap.zlen[slot]){
+    zmark(swap.zpos[slot], swap.zlen[slot], 0);
+    swap.zlen[slot] = 0;
+  }
+}
+#else
+static int zstore(uint slot, char *mem) { return -1; }
+static int zload(uint slot, char *mem) { return -1; }
+static void zdrop(uint slot) { }
+#endif
+
+// Allocate a swap slot, with a reference count of 1.
+// Returns -1 if the swap space is full.
+int
+swapalloc(void)
+{
+  int i, slot;
+
+  acquire(&swap.lock);
+  for(i = 0; i < NSWAPSLOTS; i++){
+    slot = (swap.next + i) % NSWAPSLOTS;
+    if(swap.ref[slot] == 0){
+      swap.ref[slot] = 1;
+      swap.nfree--;
+      swap.next = (slot + 1) % NSWAPSLOTS;
+      release(&swap.lock);
+      return slot;
+    }
+  }
+  release(&swap.lock);
+  return -1;
+}
+
+// Add a reference to a slot (a forked page table entry).
+void
+swapdup(uint slot)
+{
+  if(slot == ZERO_SLOT)
+    return;
+  acquire(&swap.lock);
+  if(slot >= NSWAPSLOTS || swap.ref[slot] == 0 || swap.ref[slot] == 0xff)
+    panic("swapdup");
+  swap.ref[slot]++;
+  release(&swap.lock);
+}
+
+// Drop a reference to a slot, freeing it with the last one.
+void
+swapfree(uint slot)
+{
+  if(slot == ZERO_SLOT)
+    return;
+  acquire(&swap.lock);
+  if(slot >= NSWAPSLOTS || swap.ref[slot] == 0)
+    panic("swapfree");
+  if(--swap.ref[slot] == 0){
+    swap.nfree++;
+    zdrop(slot);
+  }
+  release(&swap.lock);
+}
+
+// Number of free slots.
+int
+swapavail(void)
+{
+  return swap.nfree;
+}
+
+// Read slot into the page at mem. Returns 0 on success.
+int
+swapread(uint slot, char *mem)
+{
+  return swapreadv(slot, &mem, 1);
+}
+
+// Read n consecutive slots, starting at slot, into the pages mem[0..n-1].
+// Returns 0 on success.
+int
+swapreadv(uint slot, char **mem, int n)
+{
+  int i, j;
+
+  if(n < 1 || slot + n > NSWAPSLOTS)
+    return -1;
+  for(i = 0; i < n; i = j + 1){
+    // one disk request for the run of slots up to the next one in the pool
+    for(j = i; j < n && zload(slot + j, mem[j]) != 0; j++)
+      ;
+    if(j > i)
+      iderwpages(ROOTDEV, SLOTSECTOR(slot + i), mem + i, j - i, 0);
+  }
+  return 0;
+}
+
+// Write the page at mem to slot. Returns 0 on success.
+int
+swapwrite(uint slot, char *mem)
+{
+  if(slot >= NSWAPSLOTS)
+    return -1;
+  if(zstore(slot, mem) == 0)
+    return 0;
+  iderwpages(ROOTDEV, SLOTSECTOR(slot), &mem, 1, 1);
+  return 0;
+}
+
+// Print the compressed pool counters (for procdump).
+void
+swapdump(void)
+{
+#ifdef ZSWAP
+  uint reads = swap.zhits + swap.zmisses;
+
+  cprintf("swap pool: %d/%d chunks in %d frames, %d stored, %d spilled, %d rejected\n",
+          swap.zchunks, ZPOOL_PAGES*ZCHUNKS, swap.zframes,
+          swap.zstores, swap.zspills, swap.zrejects);
+  cprintf("swap pool: %d hits, %d misses (%d%% hit rate), compressed to %d%%\n",
+          swap.zhits, swap.zmisses, reads ? swap.zhits*100/reads : 0,
+          swap.zin ? swap.zout/(swap.zin/100) : 0);
+#endif
+}
+
+// Fill in the compressed pool counters of st (see getpgstat).
+void
+swapstat(struct pgstat *st)
+{
+#ifdef ZSWAP
+  st->zstores = swap.zstores;
+  st->zrejects = swap.zrejects;
+  st->zspills = swap.zspills;
+  st->zhits = swap.zhits;
+  st->zmisses = swap.zmisses;
+  st->zin = swap.zin;
+  st->zout = swap.zout;
+#endif
+}
@@ -3,6 +3,7 @@
 #include "param.h"
 #include "memlayout.h"
 #include "mmu.h"
+#include "pgstat.h"
 #include "proc.h"
 #include "x86.h"
 #include "syscall.h"
@@ -54,7 +55,8 @@ argint(int n, int *ip)
 
 // Fetch the nth word-sized system call argument as a pointer
 // to a block of memory of size bytes.  Check that the pointer
-// lies within the process address space.
+// lies within the process address space, and keep the block in
+// RAM until the system call returns (see prefault).
 int
 argptr(int n, char **pp, int size)
 {
@@ -65,6 +67,8 @@ argptr(int n, char **pp, int size)
     return -1;
   if(size < 0 || (uint)i >= curproc->sz || (uint)i+size > curproc->sz)
     return -1;
+  if(prefault(i, size) < 0)
+    return -1;
   *pp = (char*)i;
   return 0;
 }
@@ -104,6 +108,14 @@ extern int sys_wait(void);
 extern int sys_write(void);
 extern int sys_uptime(void);
 extern int sys_yield(void);
+extern int sys_swapra(void);
+extern int sys_pgpolicy(void);
+extern int sys_pgstat(void);
+extern int sys_pgtrace(void);
+extern int sys_halt(void);
+extern int sys_madvise(void);
+extern int sys_mlock(void);
+extern int sys_munlock(void);
 
 static int (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -128,6 +140,14 @@ static int (*syscalls[])(void) = {
 [SYS_mkdir]   sys_mkdir,
 [SYS_close]   sys_close,
 [SYS_yield]   sys_yield,
+[SYS_swapra]  sys_swapra,
+[SYS_pgpolicy] sys_pgpolicy,
+[SYS_pgstat]  sys_pgstat,
+[SYS_pgtrace] sys_pgtrace,
+[SYS_halt]    sys_halt,
+[SYS_madvise] sys_madvise,
+[SYS_mlock]   sys_mlock,
+[SYS_munlock] sys_munlock,
 };
 
 void
@@ -139,6 +159,7 @@ syscall(void)
   num = curproc->tf->eax;
   if(num > 0 && num < NELEM(syscalls) && syscalls[num]) {
     curproc->tf->eax = syscalls[num]();
+    unhold(curproc);                  // the buffer argptr held in RAM
   } else {
     cprintf("%d %s: unknown sys call %d\n",
             curproc->pid, curproc->name, num);
@@ -21,3 +21,11 @@
 #define SYS_mkdir  20
 #define SYS_close  21
 #define SYS_yield  22
+#define SYS_swapra 23
+#define SYS_pgpolicy 24
+#define SYS_pgstat 25
+#define SYS_pgtrace 26
+#define SYS_halt   27
+#define SYS_madvise 28
+#define SYS_mlock  29
+#define SYS_munlock 30
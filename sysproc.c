@@ -5,7 +5,9 @@
 #include "param.h"
 #include "memlayout.h"
 #include "mmu.h"
+#include "pgstat.h"
 #include "proc.h"
+#include "pgtrace.h"
 
 
 int sys_yield(void)
@@ -96,3 +98,139 @@ sys_uptime(void)
   release(&tickslock);
   return xticks;
 }
+
+// set the swap readahead window (pages), if n >= 0.
+// returns the previous window, -1 if n is too large or paging is off.
+int
+sys_swapra(void)
+{
+  int n;
+
+  if(argint(0, &n) < 0)
+    return -1;
+#ifdef NONE
+  return -1;
+#else
+  int old;
+  if(n > MAX_RA_WINDOW)
+    return -1;
+  old = ra_window;
+  if(n >= 0)
+    ra_window = n;
+  return old;
+#endif
+}
+
+// switch process pid (every process if pid is 0, see setpolicy) to the
+// page replacement policy called name, or to ADAPT (see adapt_miss).
+// returns -1 if there is no such policy or process, or paging is off.
+int
+sys_pgpolicy(void)
+{
+  int pid;
+  char *name;
+
+  if(argint(0, &pid) < 0 || argstr(1, &name) < 0)
+    return -1;
+#ifdef NONE
+  return -1;
+#else
+  int policy;
+  if((policy = find_policy(name)) < 0)
+    return -1;
+  return setpolicy(pid, policy);
+#endif
+}
+
+// copy the paging counters of process pid to st - of all processes and the
+// system if pid is 0 (see getpgstat).
+// returns -1 if there is no such process.
+int
+sys_pgstat(void)
+{
+  int pid;
+  struct pgstat *st, k;
+
+  if(argint(0, &pid) < 0 || argptr(1, (void*)&st, sizeof(*st)) < 0)
+    return -1;
+  //gathered apart: writing st may fault, which getpgstat's lock can't take
+  if(getpgstat(pid, &k) < 0)
+    return -1;
+  memmove(st, &k, sizeof(k));
+  return 0;
+}
+
+// the paging event trace: start or stop recording, or move up to n
+// recorded events to buf (see pgtrace.h).
+int
+sys_pgtrace(void)
+{
+  int cmd, n;
+  char *buf;
+
+  if(argint(0, &cmd) < 0)
+    return -1;
+  switch(cmd){
+  case PGTRACE_START:
+    tracestart();
+    return 0;
+  case PGTRACE_STOP:
+    return tracestop();
+  case PGTRACE_READ:
+    if(argint(2, &n) < 0 || n < 0)
+      return -1;
+    if(n > NCPU*NTRACE)               //no more are kept
+      n = NCPU*NTRACE;
+    if(argptr(1, &buf, n*sizeof(struct pgevent)) < 0)
+      return -1;
+    return traceread(buf, n);
+  }
+  return -1;
+}
+
+// advise the kernel how the process will use its pages in
+// [addr, addr+len) - see madvise.h and madvise in vm.c.
+int
+sys_madvise(void)
+{
+  int addr, len, advice;
+
+  if(argint(0, &addr) < 0 || argint(1, &len) < 0 || argint(2, &advice) < 0)
+    return -1;
+  if(len < 0)
+    return -1;
+  return madvise(myproc(), addr, len, advice);
+}
+
+// pin the process's pages in [addr, addr+len) in RAM (see mlock in vm.c)
+int
+sys_mlock(void)
+{
+  int addr, len;
+
+  if(argint(0, &addr) < 0 || argint(1, &len) < 0 || len < 0)
+    return -1;
+  return mlock(myproc(), addr, len);
+}
+
+// let the pages in [addr, addr+len) be paged out again
+int
+sys_munlock(void)
+{
+  int addr, len;
+
+  if(argint(0, &addr) < 0 || argint(1, &len) < 0 || len < 0)
+    return -1;
+  return munlock(myproc(), addr, len);
+}
+
+// power the machine off, by the ACPI port of QEMU, then that of Bochs
+// and older QEMUs - so scripted runs (make bench) end.
+// returns -1 if the machine is still on.
+int
+sys_halt(void)
+{
+  outw(0x604, 0x2000);
+  outw(0xB004, 0x2000);
+  return -1;
+}
@@ -0,0 +1,123 @@
+// Paging event trace.
+//
+// Page faults, page-ins and evictions are recorded in a ring per CPU.
+// Recording takes no lock: a ring has one writer, its own CPU, running
+// with interrupts off, and the readers only move the tail.  An event that
+// finds its ring full is dropped and counted.  pgtrace moves the events
+// to user space.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "pgstat.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "pgtrace.h"
+
+struct ring {
+  struct pgevent ev[NTRACE];
+  volatile uint head;           // events written, by the CPU
+  volatile uint tail;           // events read
+  uint lost;                    // events dropped while the ring was full
+};
+
+static struct ring rings[NCPU];
+static struct spinlock readlock;  // one reader at a time
+static volatile int tracing;
+static uint seq;
+
+void
+traceinit(void)
+{
+  initlock(&readlock, "trace");
+}
+
+// Record an event of process p at vaddr.
+void
+trace(int kind, struct proc *p, uint vaddr)
+{
+  struct ring *r;
+  struct pgevent *e;
+
+  if(!tracing)
+    return;
+  pushcli();
+  r = &rings[cpuid()];
+  if(r->head - r->tail == NTRACE)
+    r->lost++;
+  else {
+    e = &r->ev[r->head % NTRACE];
+    e->seq = __sync_fetch_and_add(&seq, 1);
+    e->tick = ticks;
+    e->vaddr = vaddr;
+    e->pid = p->pid;
+    e->kind = kind;
+#ifdef NONE
+    e->policy = 0xff;
+#else
+    e->policy = p->adapt || p->policy < 0 ? 0xff : p->policy;
+#endif
+    __sync_synchronize();         // the event is written before it is published
+    r->head++;
+  }
+  popcli();
+}
+
+// Drop the events recorded so far and start recording.
+void
+tracestart(void)
+{
+  int i;
+
+  acquire(&readlock);
+  for(i = 0; i < NCPU; i++){
+    rings[i].tail = rings[i].head;
+    rings[i].lost = 0;
+  }
+  tracing = 1;
+  release(&readlock);
+}
+
+// Stop recording.  Returns the number of events lost.
+int
+tracestop(void)
+{
+  int i, lost = 0;
+
+  tracing = 0;
+  acquire(&readlock);
+  for(i = 0; i < NCPU; i++)
+    lost += rings[i].lost;
+  release(&readlock);
+  return lost;
+}
+
+// Move up to n events to user memory at dst, a CPU's ring at a time.
+// Returns the number of events moved.
+int
+traceread(char *dst, int n)
+{
+  struct pgevent buf[32];
+  struct ring *r;
+  int i, m, got = 0;
+
+  for(i = 0; i < NCPU && got < n; i++){
+    r = &rings[i];
+    for(;;){
+      //copied out of the ring first: writing dst may fault
+      acquire(&readlock);
+      for(m = 0; m < NELEM(buf) && got + m < n && r->tail != r->head; m++){
+        memmove(&buf[m], &r->ev[r->tail % NTRACE], sizeof(buf[m]));
+        __sync_synchronize();     // the event is read before its place is freed
+        r->tail++;
+      }
+      release(&readlock);
+      if(m == 0)
+        break;
+      memmove(dst + got*sizeof(buf[0]), buf, m*sizeof(buf[0]));
+      got += m;
+    }
+  }
+  return got;
+}
@@ -3,6 +3,7 @@
 #include "param.h"
 #include "memlayout.h"
 #include "mmu.h"
+#include "pgstat.h"
 #include "proc.h"
 #include "x86.h"
 #include "traps.h"
@@ -80,19 +81,16 @@ trap(struct trapframe *tf)
     break;
 
   //page fault
-  #ifndef NONE
   case T_PGFLT:
-    
+  #ifndef NONE
     //added task 3
     if(myproc()){
       myproc()->page_faults++;
     }
-    //if a process is running this  AND the page is Paged-out in the back    
-    if(is_user_proc(myproc()) && isPagedOut(myproc(),(void *)rcr2())){
-      safe_page_in(myproc(),(void *)rcr2());  //page another one OUT, and page this one IN
-      break;
-      }
   #endif
+    //copy-on-write, lazily allocated or paged out page
+    if(myproc() && page_fault(myproc(),rcr2(),tf->err & FEC_WR))
+      break;
   //PAGEBREAK: 13
   default:
     if(myproc() == 0 || (tf->cs&3) == 0){
@@ -119,9 +117,7 @@ trap(struct trapframe *tf)
   // If interrupts were on while locks held, would need to check nlock.
   if(myproc() && myproc()->state == RUNNING &&
      tf->trapno == T_IRQ0+IRQ_TIMER){
-     #ifndef NONE
-     age_process_pages(myproc());       //update aging of pages.
-     #endif
+    myproc()->vticks++;
     yield();
   }
 
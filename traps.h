@@ -16,6 +16,7 @@
 #define T_STACK         12      // stack exception
 #define T_GPFLT         13      // general protection fault
 #define T_PGFLT         14      // page fault
+#define FEC_WR          0x2     // page fault error code: caused by a write
 // #define T_RES        15      // reserved
 #define T_FPERR         16      // floating point error
 #define T_ALIGN         17      // aligment check
@@ -1,4 +1,6 @@
 struct stat;
+struct pgstat;
+struct pgevent;
 struct rtcdate;
 
 // system calls
@@ -24,6 +26,14 @@ char* sbrk(int);
 int sleep(int);
 int uptime(void);
 int yield(void);
+int swapra(int);
+int pgpolicy(int, char*);
+int pgstat(int, struct pgstat*);
+int pgtrace(int, struct pgevent*, int);
+int halt(void);
+int madvise(void*, int, int);
+int mlock(void*, int);
+int munlock(void*, int);
 
 // ulib.c
 int stat(char*, struct stat*);
@@ -4,12 +4,16 @@
 #include "x86.h"
 #include "memlayout.h"
 #include "mmu.h"
+#include "pgstat.h"
 #include "proc.h"
 #include "elf.h"
+#include "traps.h"
+#include "spinlock.h"
+#include "pgtrace.h"
+#include "madvise.h"
 
 extern char data[];  // defined by kernel.ld
 pde_t *kpgdir;  // for use in scheduler()
-void*   select_page_to_back(struct proc *p);
 // Set up CPU's kernel segment descriptors.
 // Run once on entry on each CPU.
 void
@@ -179,6 +183,62 @@ switchuvm(struct proc *p)
   popcli();
 }
 
+// TLB invalidation.  Once a page table entry loses rights (or its accessed
+// bit), the stale translation must be dropped.  Only this CPU can hold one:
+// a page table is changed by its own process, or by another one while the
+// owner is off the CPUs (pgtrylock), and there are no shared address
+// spaces.  A CPU that switches to the owner reloads cr3, dropping all of
+// its entries, so an invlpg here is enough.
+
+//drop the translation of page va of pgdir from the TLB, if pgdir is loaded.
+void
+tlb_flush_page(pde_t *pgdir, void *va)
+{
+  pushcli();
+  if(rcr3() == V2P(pgdir))
+    invlpg(va);
+  popcli();
+}
+
+// A bulk change of a page table is flushed in batches: the pages are
+// invalidated together, and the frames they held are only freed after.
+#define TLB_BATCH 32
+
+struct tlb_batch {
+  pde_t *pgdir;
+  int n;
+  char *va[TLB_BATCH];
+  char *mem[TLB_BATCH];                 //frame to free after the flush, or 0
+};
+
+static void
+tlb_batch_flush(struct tlb_batch *b)
+{
+  int i;
+
+  if(b->n == 0)
+    return;
+  pushcli();
+  if(rcr3() == V2P(b->pgdir))
+    for(i = 0; i < b->n; i++)
+      invlpg(b->va[i]);
+  popcli();
+  for(i = 0; i < b->n; i++)
+    if(b->mem[i])
+      kfree(b->mem[i]);
+  b->n = 0;
+}
+
+//add page va, which held frame mem (0: no frame to free), to the batch
+static void
+tlb_batch_add(struct tlb_batch *b, uint va, char *mem)
+{
+  if(b->n == TLB_BATCH)
+    tlb_batch_flush(b);
+  b->va[b->n] = (char*)va;
+  b->mem[b->n++] = mem;
+}
+
 // Load the initcode into address 0 of pgdir.
 // sz must be less than a page.
 void
@@ -218,6 +278,125 @@ loaduvm(pde_t *pgdir, char *addr, struct inode *ip, uint offset, uint sz)
   return 0;
 }
 
+#ifndef NONE
+// Paging meta-data of a process: a struct page for every page it owns, kept
+// in a radix tree indexed by page number (see PMETA_LEAF in mmu.h).
+// Directory and leaf pages are allocated as pages are added, so a process
+// pays only for the part of its address space it actually uses.
+#define PMETA_DIRX(va)   (((uint)(va) >> PGSHIFT) / (PMETA_LEAF * NPDENTRIES))
+#define PMETA_MIDX(va)   ((((uint)(va) >> PGSHIFT) / PMETA_LEAF) % NPDENTRIES)
+#define PMETA_LEAFX(va)  (((uint)(va) >> PGSHIFT) % PMETA_LEAF)
+
+//a leaf is one kalloc()ed page: fails to compile if its records outgrow it
+typedef char pmeta_leaf_fits[PMETA_LEAF * sizeof(struct page) <= PGSIZE ? 1 : -1];
+
+// Return the meta-data entry of page vaddr.  If alloc!=0,
+// create any required directory and leaf pages.
+static struct page*
+page_lookup(struct proc *p, const void *vaddr, int alloc){
+  struct page ***dir = &p->paging_meta.dir[PMETA_DIRX(vaddr)];
+  struct page **leaf;
+
+  if(*dir == 0){
+    if(!alloc || (*dir = (struct page**)kalloc()) == 0)
+      return 0;
+    memset(*dir, 0, PGSIZE);
+  }
+  leaf = &(*dir)[PMETA_MIDX(vaddr)];
+  if(*leaf == 0){
+    if(!alloc || (*leaf = (struct page*)kalloc()) == 0)
+      return 0;
+    memset(*leaf, 0, PGSIZE);
+  }
+  return &(*leaf)[PMETA_LEAFX(vaddr)];
+}
+
+//find the meta-data entry of a tracked page
+struct page*
+find_page(struct proc *p, const void *vaddr){
+  struct page *pg = page_lookup(p, vaddr, 0);
+
+  if(pg == 0 || !pg->exists)
+    return 0;
+  return pg;
+}
+
+//the page table entry of user page vaddr of p, 0 if it has no page table
+pte_t*
+pgpte(struct proc *p, void *vaddr){
+  return walkpgdir(p->pgdir,vaddr,0);
+}
+
+// Swap readahead: a fault also reads in the following pages, as long as
+// they went to the following swap slots (see swap_in).  A page read ahead
+// is a hit once it is accessed, a miss if it leaves RAM untouched.
+int ra_window = RA_WINDOW;              //pages read ahead, 0 turns it off
+uint ra_reads, ra_hits, ra_misses;
+
+// Zero pages: a page that holds only zeros when paged out gets ZERO_SLOT
+// instead of a swap slot, and is paged back in by mapping the shared
+// zero frame read-only (copy-on-write if the page is writable).
+static char *zero_page;
+uint zero_outs, zero_ins;
+uint clean_outs;                        //pages paged out without a write (see out_slot)
+
+//account for a page read ahead, given its entry. leaving - it's leaving RAM
+void
+ra_account(struct page *pg, pte_t pte, int leaving){
+  if(pg == 0 || !pg->ra)
+    return;
+  if(pte & PTE_A)
+    ra_hits++;
+  else if(leaving)
+    ra_misses++;
+  else
+    return;
+  pg->ra = 0;
+}
+
+//forget a page that is being freed (resident or paged out)
+static void
+remove_page(struct proc *p,void *vaddr){
+  struct p_meta *meta=&p->paging_meta;
+  struct page *pg=find_page(p,vaddr);
+  pte_t *pte;
+
+  if(pg == 0)
+    return;
+  if(!pg->in_back && (pte = walkpgdir(p->pgdir,vaddr,0)) != 0)
+    ra_account(pg,*pte,1);
+  if(pg->in_back)
+    meta->num_in_back--;
+  else{
+    meta->num_in_ram--;
+    free_from_queue(p,pg);
+  }
+  if(pg->slot >= 0)
+    swapfree(pg->slot);
+  if(pg->pinned)
+    meta->num_pinned--;
+  if(pg->held)
+    meta->num_held--;
+  memset(pg,0,sizeof(*pg));
+}
+
+//paging is done for user processes, on their own page table
+static struct proc*
+paging_proc(pde_t *pgdir){
+  struct proc *p=myproc();
+
+  if(p && pgdir == p->pgdir && is_user_proc(p))
+    return p;
+  return 0;
+}
+
+static int need_room(struct proc *p);
+static void wake_kswapd(struct proc *p);
+static int make_room(struct proc *p);
+static int advise_pages(struct proc *p, uint va, uint end, int advice);
+static void willneed(struct proc *p, uint va, uint end);
+#endif
+
 // Allocate page tables and physical memory to grow process from oldsz to
 // newsz, which need not be page aligned.  Returns new size or 0 on error.
 int
@@ -225,6 +404,9 @@ allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
 {
   char *mem;
   uint a;
+  #ifndef NONE
+  struct proc *p = paging_proc(pgdir);
+  #endif
   if(newsz >= KERNBASE)
     return 0;
   if(newsz < oldsz)
@@ -232,13 +414,11 @@ allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
   a = PGROUNDUP(oldsz);
   for(; a < newsz; a += PGSIZE){
     #ifndef NONE
-    //add new page
-    if(myproc()){
-      int pages_in_ram=numOfPagedIn(myproc());
-      if(pages_in_ram == MAX_PSYC_PAGES){
-        //cprintf("ram full\n");
-        pageOut(myproc(),select_page_to_back(myproc()));
-      }
+    //add new page - make room for it first if RAM is full
+    if(p && need_room(p) && !make_room(p)){
+      cprintf("allocuvm out of swap space\n");
+      deallocuvm(pgdir, newsz, oldsz);
+      return 0;
     }
     #endif
     mem = kalloc();    
@@ -255,41 +435,16 @@ allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
       return 0;
     }
     #ifndef NONE
-    add_new_page(myproc(),(void *)a);
+    if(p && !add_new_page(p,(void *)a)){
+      cprintf("allocuvm out of memory (3)\n");
+      deallocuvm(pgdir, newsz, oldsz);
+      return 0;
+    }
     #endif
   }
   return newsz;
 }
 
-
-//when freeing memory   -   remove this page from queue
-void
-free_from_queue(struct proc *p,void* vaddr){
-  struct p_meta *meta;
-  meta=&p->paging_meta;
-  struct page_queue *pq=&meta->pq;
-  int to_del;     //index of page to delete from queue
-  for(to_del = 0; to_del<MAX_TOTAL_PAGES; to_del++){
-    if(!(pq->pages[to_del].exists && pq->pages[to_del].vaddr == vaddr))
-      continue;
-    pq->lastIndex--;
-    break;
-  }
-  int i;
-  for(i=to_del; i<MAX_TOTAL_PAGES; i++){
-    if(i == MAX_TOTAL_PAGES-1){ //if its the last one, just delete it
-      pq->pages[i].exists = 0;
-      pq->pages[i].vaddr  = 0;
-      pq->pages[i].age    = 0;
-      pq->pages[i].age2   = 0;
-      pq->pages[i].in_back= 0;
-    }
-    else
-      pq->pages[i] = pq->pages[i + 1];  //shift    
-  }
-}
-
-
 // Deallocate user pages to bring the process size from oldsz to
 // newsz.  oldsz and newsz need not be page-aligned, nor does newsz
 // need to be less than oldsz.  oldsz can be larger than the actual
@@ -299,6 +454,10 @@ deallocuvm(pde_t *pgdir, uint oldsz, uint newsz)
 {
   pte_t *pte;
   uint a, pa;
+  struct tlb_batch b = { pgdir, 0 };
+  #ifndef NONE
+  struct proc *p = paging_proc(pgdir);
+  #endif
 
   if(newsz >= oldsz)
     return oldsz;
@@ -314,28 +473,23 @@ deallocuvm(pde_t *pgdir, uint oldsz, uint newsz)
         panic("kfree");
       char *v = P2V(pa);
       #ifndef NONE
-      if(myproc() && pgdir == myproc()->pgdir){
-          struct p_meta *meta=&myproc()->paging_meta;
-          struct page *pages=meta->pages;
-          int i;
-          for(i=0; i<MAX_TOTAL_PAGES; i++){
-            if(pages[i].exists && pages[i].vaddr ==(void *) a){
-              pages[i].age=0;
-              pages[i].age2=0xffffffff;
-              pages[i].in_back=0;
-              pages[i].offset=0;
-              pages[i].vaddr=0;
-              pages[i].exists=0;
-            }
-          }
-          free_from_queue(myproc(),(void *)a);
-      }
+      if(p)
+        remove_page(p,(void *)a);
       #endif
 
-      kfree(v);
       *pte = 0;
+      tlb_batch_add(&b, a, v);          //freed once it is flushed
     }
+    #ifndef NONE
+    else if((*pte & PTE_PG) != 0){    //paged out - release its swap slot
+      swapfree(PTE_SLOT(*pte));
+      if(p)
+        remove_page(p,(void *)a);
+      *pte = 0;
+    }
+    #endif
   }
+  tlb_batch_flush(&b);
   return newsz;
 }
 // Free a page table and all the physical memory pages
@@ -375,46 +529,403 @@ pde_t*
 copyuvm(pde_t *pgdir, uint sz)
 {
   pde_t *d;
-  pte_t *pte;
-  uint pa, i, flags;
-  char *mem;
-  int paged_out = 0;
+  pte_t *pte, *cpte;
+  struct tlb_batch b = { pgdir, 0 };
+  uint i;
   if((d = setupkvm()) == 0)
     return 0;
   for(i = 0; i < sz; i += PGSIZE){
-    if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0)
-      panic("copyuvm: pte should exist");
-    if(!(*pte & PTE_P) && !(*pte & PTE_PG))
-      panic("copyuvm: page not present");
-    //if paged out , turn off the PTE_P flag , AFTER mappages (which turns it on always).
-    if((*pte & PTE_PG) > 0){ 
-      paged_out = 1;
-      pte = walkpgdir(pgdir, (void *) i, 0);
-      *pte=PTE_PG | PTE_U | PTE_W;    //mark as writable, for user and Page out! (NOT present.)
+    //heap pages that were never touched (lazy sbrk) are not copied
+    if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0){
+      i = PGADDR(PDX(i) + 1, 0, 0) - PGSIZE;
+      continue;
     }
-    else  
-      paged_out = 0;
-    pa = PTE_ADDR(*pte);
-    flags = PTE_FLAGS(*pte);
-    if((mem = kalloc()) == 0)
-      goto bad;
-    memmove(mem, (char*)P2V(pa), PGSIZE);
-    if(mappages(d, (void*)i, PGSIZE, V2P(mem), flags) < 0)
+    if(!(*pte & PTE_P) && !(*pte & PTE_PG))
+      continue;
+    if((cpte = walkpgdir(d, (void *) i, 1)) == 0)
       goto bad;
-    //change the PTE_P flag again.
-    if(paged_out){
-      pte = walkpgdir(d, (void *) i, 0);
-      *pte &=~PTE_P;  //mark not present!
-
+    //if paged out, the entry holds the swap slot - the child shares the slot.
+    if((*pte & PTE_PG) != 0){
+      swapdup(PTE_SLOT(*pte));
+      *cpte = *pte;
+      continue;
     }
+    //share the frame, read-only on both sides until one of them writes it
+    if(*pte & PTE_W){
+      *pte = (*pte & ~PTE_W) | PTE_COW;
+      tlb_batch_add(&b, i, 0);
+    }
+    kref(PTE_ADDR(*pte));
+    *cpte = *pte;
   }
+  tlb_batch_flush(&b);  //the parent's pages are now read-only
   return d;
 
 bad:
   freevm(d);
+  tlb_batch_flush(&b);
   return 0;
 }
 
+// Allocate and zero the page at va of a lazily grown (sbrk) heap.
+// Returns 0 if va is not an unallocated page below p->sz, or out of memory.
+static int
+demand_zero(struct proc *p, uint va)
+{
+  pte_t *pte;
+
+  va = PGROUNDDOWN(va);
+  if(va >= p->sz)
+    return 0;
+  pte = walkpgdir(p->pgdir, (void*)va, 0);
+  if(pte && (*pte & (PTE_P|PTE_PG)))
+    return 0;
+  return allocuvm(p->pgdir, va, va + PGSIZE) != 0;
+}
+
+// Read the page at va of a program segment from the program file,
+// zeroing the rest (bss).  Returns 0 if va is not in a segment, or already
+// mapped, or out of memory.
+static int
+demand_load(struct proc *p, uint va)
+{
+  struct segment *s;
+  pte_t *pte;
+  uint n;
+  int r;
+
+  va = PGROUNDDOWN(va);
+  for(s = p->seg; s < &p->seg[p->nseg]; s++)
+    if(va >= s->vaddr && va < s->vaddr + s->memsz)
+      break;
+  if(s == &p->seg[p->nseg])
+    return 0;
+  pte = walkpgdir(p->pgdir, (void*)va, 0);
+  if(pte && (*pte & (PTE_P|PTE_PG)))
+    return 0;
+  if(allocuvm(p->pgdir, va, va + PGSIZE) == 0)
+    return 0;
+  if(va - s->vaddr >= s->filesz)
+    return 1;                       //bss - no read
+  p->pgc.major++;
+  n = s->filesz - (va - s->vaddr);
+  if(n > PGSIZE)
+    n = PGSIZE;
+  ilock(p->image);
+  r = loaduvm(p->pgdir, (char*)va, p->image, s->off + (va - s->vaddr), n);
+  iunlock(p->image);
+  return r == 0;
+}
+
+// Make the page at va of p accessible: copy it (copy-on-write), load it
+// (exec), allocate it (lazy sbrk) or page it in.  Returns 0 if it can't be.
+static int
+fault_in(struct proc *p, uint va, int write)
+{
+  int ok;
+  #ifndef NONE
+  struct page *pg;
+  #endif
+
+  #ifndef NONE
+  if(is_user_proc(p)){
+    //the paging lock keeps kswapd and ksmd off the page table meanwhile
+    pglock(p);
+    ok = (write && cow_fault(p, va)) ||
+         safe_page_in(p, (void*)va) || demand_load(p, va) || demand_zero(p, va);
+    if(ok && (pg = find_page(p, (void*)PGROUNDDOWN(va))) && pg->advice == MADV_SEQUENTIAL)
+      p->paging_meta.seq_pos = PGROUNDDOWN(va);     //see seq_passed
+    pgunlock(p);
+    if(ok)
+      wake_kswapd(p);
+    return ok;
+  }
+  #endif
+  if(write && cow_fault(p, va))
+    return 1;
+  ok = demand_load(p, va) || demand_zero(p, va);
+  return ok;
+}
+
+// Handle a page fault of p at va, counting it in p's paging counters.
+// Returns 1 if the page was made accessible.
+int
+page_fault(struct proc *p, uint va, int write)
+{
+  uint t0 = rdtsc(), major = p->pgc.major, t;
+  int i;
+
+  trace(PGEV_FAULT, p, va);
+  if(!fault_in(p, va, write))
+    return 0;
+  if(p->pgc.major == major)         //nothing was read
+    p->pgc.minor++;
+  t = rdtsc() - t0;
+  for(i = 0; t > 1 && i < PGLAT_NBUCKET - 1; i++)
+    t >>= 1;
+  p->pgc.lat[i]++;
+  return 1;
+}
+
+// Advise the kernel how p will use its pages in [va, va+len) (see madvise.h).
+// RANDOM and SEQUENTIAL stay with the pages until they are freed.
+// Returns -1 if the range is not page aligned or not in p, the advice
+// is unknown, or the kernel is out of memory.
+int
+madvise(struct proc *p, uint va, uint len, int advice)
+{
+  uint a, end = va + PGROUNDUP(len);
+  pte_t *pte;
+  int r = 0;
+  #ifndef NONE
+  struct page *pg;
+  int old;
+  #endif
+
+  if(va % PGSIZE || end < va || end > p->sz ||
+     advice < MADV_NORMAL || advice > MADV_DONTNEED)
+    return -1;
+  pglock(p);
+  if(advice == MADV_DONTNEED){
+    for(a = va; a < end; a += PGSIZE){
+      pte = walkpgdir(p->pgdir, (void*)a, 0);
+      if(pte == 0 || !(*pte & (PTE_P|PTE_PG)) || !(*pte & PTE_U))
+        continue;                          //the stack guard stays
+      #ifndef NONE
+      if((pg = find_page(p,(void*)a)) != 0 && pg->pinned)
+        continue;                          //mlock'ed pages stay
+      old = (pg = page_lookup(p,(void*)a,0)) ? pg->advice : 0;
+      #endif
+      deallocuvm(p->pgdir, a + PGSIZE, a);
+      #ifndef NONE
+      if(old && (pg = page_lookup(p,(void*)a,1)) != 0)
+        pg->advice = old;                  //the range keeps its advice
+      #endif
+    }
+  }
+  #ifndef NONE
+  else if(is_user_proc(p) && advice == MADV_WILLNEED)
+    willneed(p, va, end);
+  else if(is_user_proc(p))
+    r = advise_pages(p, va, end, advice);
+  #endif
+  pgunlock(p);
+  #ifndef NONE
+  if(is_user_proc(p))
+    wake_kswapd(p);
+  #endif
+  return r;
+}
+
+#ifndef NONE
+//bring p's page at va into RAM, as a fault would.  the caller holds p's paging lock.
+static int
+make_resident(struct proc *p, uint va)
+{
+  pte_t *pte = walkpgdir(p->pgdir, (void*)va, 0);
+
+  if(pte && (*pte & PTE_P))
+    return 1;
+  return safe_page_in(p, (void*)va) || demand_load(p, va) || demand_zero(p, va);
+}
+#endif
+
+// Pin p's pages in [va, va+len) in RAM: bring them in, and take them off
+// the page queue, where every policy looks for the page to page out.
+// Returns -1 if the range is not page aligned or not in p, p would pin
+// more than MAX_PINNED pages, or a page can't be brought in.
+int
+mlock(struct proc *p, uint va, uint len)
+{
+  uint end = va + PGROUNDUP(len);
+  #ifndef NONE
+  struct p_meta *meta = &p->paging_meta;
+  struct page *pg;
+  uint a;
+  int n = 0, r = 0;
+  #endif
+
+  if(va % PGSIZE || end < va || end > p->sz)
+    return -1;
+  #ifndef NONE
+  if(!is_user_proc(p))
+    return 0;                                //never paged out anyway
+  pglock(p);
+  for(a = va; a < end; a += PGSIZE)
+    if((pg = find_page(p, (void*)a)) == 0 || !pg->pinned)
+      n++;
+  if(meta->num_pinned + n > MAX_PINNED)
+    r = -1;
+  //the pages pinned already are off the queue, so none is paged out again
+  for(a = va; r == 0 && a < end; a += PGSIZE){
+    if(!make_resident(p, a) || (pg = find_page(p, (void*)a)) == 0){
+      r = -1;
+      break;
+    }
+    if(pg->pinned)
+      continue;
+    free_from_queue(p, pg);
+    pg->pinned = 1;
+    meta->num_pinned++;
+  }
+  pgunlock(p);
+  wake_kswapd(p);
+  return r;
+  #else
+  return 0;
+  #endif
+}
+
+// Unpin p's pages in [va, va+len): they may be paged out again.
+// Returns -1 if the range is not page aligned or not in p.
+int
+munlock(struct proc *p, uint va, uint len)
+{
+  uint end = va + PGROUNDUP(len);
+  #ifndef NONE
+  struct page *pg;
+  uint a;
+  #endif
+
+  if(va % PGSIZE || end < va || end > p->sz)
+    return -1;
+  #ifndef NONE
+  if(!is_user_proc(p))
+    return 0;
+  pglock(p);
+  for(a = va; a < end; a += PGSIZE){
+    if((pg = find_page(p, (void*)a)) == 0 || !pg->pinned)
+      continue;
+    pg->pinned = 0;
+    p->paging_meta.num_pinned--;
+    enqueue(p, pg);                          //the queue exists, it can't fail
+  }
+  pgunlock(p);
+  #endif
+  return 0;
+}
+
+#ifndef NONE
+//hold the resident page va of p in RAM until unhold: take it off the page
+//queue, where the policies look for the page to page out, and out of p's
+//allowance (see charged).  a copy-on-write page (shared after fork, the
+//zero frame, a merged frame) gets its own copy first, so a kernel write
+//to it can't fault either.  returns 0 if the page can't be brought back
+//in, or copied.
+static int
+hold(struct proc *p, uint va)
+{
+  struct p_meta *meta = &p->paging_meta;
+  struct page *pg;
+  pte_t *pte;
+  int ok;
+
+  pglock(p);
+  //kswapd may have taken it since it was faulted in
+  ok = make_resident(p, va);
+  if(ok && (pte = walkpgdir(p->pgdir, (void*)va, 0)) && (*pte & PTE_COW))
+    ok = cow_fault(p, va);
+  if(ok && (pg = find_page(p, (void*)va)) && !pg->held){
+    if(!pg->pinned)
+      free_from_queue(p, pg);
+    pg->held = 1;
+    if(meta->num_held++ == 0 || va < meta->held_va)
+      meta->held_va = va;
+    if(va + PGSIZE > meta->held_end)
+      meta->held_end = va + PGSIZE;
+  }
+  pgunlock(p);
+  return ok;
+}
+#endif
+
+// Bring the user pages in [va, va+len) of the current process into memory
+// ahead of a kernel access, which may be made while holding a spinlock,
+// and hold them there until the system call returns (see unhold): the
+// process may sleep before the access, and no page may be paged out
+// meanwhile.  A buffer larger than the RAM allowance is held whole.
+// Returns -1 if a page can't be brought in.
+int
+prefault(uint va, uint len)
+{
+  struct proc *p = myproc();
+  pte_t *pte;
+  uint a;
+
+  for(a = PGROUNDDOWN(va); a < va + len; a += PGSIZE){
+    pte = walkpgdir(p->pgdir, (void*)a, 0);
+    if((pte == 0 || !(*pte & PTE_P)) && !page_fault(p, a, 0))
+      return -1;
+    #ifndef NONE
+    if(is_user_proc(p) && !hold(p, a))
+      return -1;
+    #endif
+  }
+  return 0;
+}
+
+// Let the pages prefault held for the system call of p that is returning
+// be paged out again.
+void
+unhold(struct proc *p)
+{
+  #ifndef NONE
+  struct p_meta *meta = &p->paging_meta;
+  struct page *pg;
+  uint a;
+
+  if(meta->num_held == 0)
+    return;
+  pglock(p);
+  for(a = meta->held_va; a < meta->held_end; a += PGSIZE){
+    if((pg = find_page(p, (void*)a)) == 0 || !pg->held)
+      continue;
+    pg->held = 0;
+    meta->num_held--;
+    if(!pg->pinned)
+      enqueue(p, pg);                        //the queue exists, it can't fail
+  }
+  meta->held_va = meta->held_end = 0;
+  pgunlock(p);
+  wake_kswapd(p);                            //the pages count again
+  #endif
+}
+
+// Handle a write fault at va on a copy-on-write page.
+// The faulting side gets its own copy, unless it is the last one
+// sharing the frame.  Returns 0 if va is not a copy-on-write page,
+// or no memory is left.
+int
+cow_fault(struct proc *p, uint va)
+{
+  pte_t *pte;
+  uint pa;
+  char *mem, *old = 0;
+
+  va = PGROUNDDOWN(va);
+  if(va >= p->sz || (pte = walkpgdir(p->pgdir, (void*)va, 0)) == 0)
+    return 0;
+  if((*pte & (PTE_P|PTE_U|PTE_COW)) != (PTE_P|PTE_U|PTE_COW))
+    return 0;
+  pa = PTE_ADDR(*pte);
+  if(krefcount(pa) > 1 || frame_merged(pa)){
+    if((mem = kalloc()) == 0)
+      return 0;
+    memmove(mem, (char*)P2V(pa), PGSIZE);
+    *pte = V2P(mem) | PTE_FLAGS(*pte);
+    old = (char*)P2V(pa);
+    #ifndef NONE
+    if(is_user_proc(p))
+      set_frame_owner(V2P(mem), p, (void*)va);
+    #endif
+  }
+  *pte = (*pte & ~PTE_COW) | PTE_W;
+  tlb_flush_page(p->pgdir, (void*)va);
+  if(old)
+    kfree(old);                     //drop our reference to the shared frame
+  return 1;
+}
+
 //PAGEBREAK!
 // Map user virtual address to kernel address.
 char*
@@ -460,515 +971,876 @@ copyout(pde_t *pgdir, uint va, void *p, uint len)
 
 
 #ifndef NONE
-// Our new Functions
-int enqueue(struct proc *pr,struct page toAdd) {
-    struct p_meta *meta;
-    meta=&pr->paging_meta;
-    
-    // int k;
-    // cprintf("Before enq - last index: %d\n",meta->pq.lastIndex);
-    //   for(k=0; k<=meta->pq.lastIndex; k++){
-    //     cprintf("<%d,%x>\n", meta->pq.pages[k].exists,meta->pq.pages[k].vaddr);
-    //   }
-    if (meta->pq.lastIndex == MAX_TOTAL_PAGES) {
-        panic("enqueue");
-    } else {
-        meta->pq.pages[meta->pq.lastIndex] = toAdd;
-        meta->pq.lastIndex++;
-
-      // cprintf("After enq- last index: %d\n",meta->pq.lastIndex);
-      // for(k=0; k<=meta->pq.lastIndex; k++){
-      //   cprintf("<%d,%x>\n", meta->pq.pages[k].exists,meta->pq.pages[k].vaddr);
-      // }
-
-
-        return 1;
+//  Map mem, holding the contents of the paged out page at vaddr (entry pte), in its place.
+//  The swap slot is taken from the entry itself, so no meta-data scan is needed to find it.
+static int
+map_in(struct proc *p, void* vaddr, pte_t *pte, char *mem){
+    uint slot=PTE_SLOT(*pte);
+    uint flags=PTE_FLAGS(*pte) & ~(PTE_PG|PTE_A|PTE_D);
+    struct page *pg=find_page(p,vaddr);
+
+    if(pg)
+      pg->slot=slot;                            //swap keeps the page while it's clean
+    else
+      swapfree(slot);                           //a child may still share the slot
+    if(flags & PTE_COW)                         //the new frame is ours alone
+      flags = (flags & ~PTE_COW) | PTE_W;
+    *pte = V2P(mem) | flags | PTE_P;
+    set_frame_owner(V2P(mem),p,vaddr);
+    trace(PGEV_PAGEIN,p,(uint)vaddr);
+    return page_in_meta(p,vaddr);               //update the meta data of the process
+}
+
+#ifndef GLOBAL
+//pages of p in RAM that count against its allowance: all but those held
+//for a system call (see prefault)
+static int
+charged(struct proc *p){
+  return numOfPagedIn(p) - p->paging_meta.num_held;
+}
+#endif
+
+//1 if n more pages may be read ahead into RAM without crossing kswapd's low watermark
+static int
+ra_room(struct proc *p, int n){
+#ifdef GLOBAL
+  return num_free() - n >= FREE_LOW;
+#else
+  return ram_quota(p) - charged(p) - n >= PSYC_LOW;
+#endif
+}
+
+//  Map the shared zero frame at vaddr (entry pte) of a page paged out as ZERO_SLOT.
+static int
+map_zero(struct proc *p, void* vaddr, pte_t *pte){
+    uint flags=PTE_FLAGS(*pte) & ~(PTE_PG|PTE_A|PTE_D);
+
+    if(flags & PTE_W)                           //first write gets its own copy
+      flags = (flags & ~PTE_W) | PTE_COW;
+    kref(V2P(zero_page));
+    *pte = V2P(zero_page) | flags | PTE_P;
+    zero_ins++;
+    trace(PGEV_PAGEIN,p,(uint)vaddr);
+    return page_in_meta(p,vaddr);
+}
+
+//  Page in the page at vaddr, whose (non present) entry is pte, together
+//  with the pages after it that went to the swap slots after its slot.
+//  All of them are read from swap at once.
+//  Called only when there's room for vaddr in memory.
+static int
+swap_in(struct proc *p, void* vaddr, pte_t *pte){
+    void *va[1+MAX_RA_WINDOW];
+    pte_t *ptes[1+MAX_RA_WINDOW], *e;
+    char *mem[1+MAX_RA_WINDOW];                 //kernel addresses of the new physical pages
+    uint slot=PTE_SLOT(*pte);
+    struct page *pg=find_page(p,vaddr);
+    int i, n=1, window=ra_window;
+
+    if(slot == ZERO_SLOT)
+      return map_zero(p,vaddr,pte);
+    if(pg && pg->advice == MADV_RANDOM)
+      window=0;
+    else if(pg && pg->advice == MADV_SEQUENTIAL)
+      window=MAX_RA_WINDOW;
+    va[0]=vaddr;
+    ptes[0]=pte;
+    //n-1 pages are already read ahead, there must be room for vaddr and one more
+    while(n <= window && ra_room(p,n+1)){
+      va[n]=(char*)vaddr + n*PGSIZE;
+      e=walkpgdir(p->pgdir,va[n],0);
+      if(e == 0 || (*e & PTE_P) || !(*e & PTE_PG) || PTE_SLOT(*e) != slot+n)
+        break;
+      ptes[n++]=e;
     }
+    for(i=0; i<n; i++)
+      if((mem[i] = kalloc()) == 0)
+        break;
+    if((n = i) == 0)
+      return 0;
+    if(swapreadv(slot,mem,n) != 0)
+      panic("get page error");
+    p->pgc.major++;
+    p->pgc.pages_in += n;
+    p->pgc.swap_read += n*PGSIZE;
+    for(i=0; i<n; i++){
+      if(!map_in(p,va[i],ptes[i],mem[i]))
+        break;
+      if(i > 0 && (pg = find_page(p,va[i])) != 0){
+        pg->ra=1;
+        ra_reads++;
+      }
+    }
+    //out of meta-data memory: the pages not mapped stay paged out, in their slots
+    for(n--; n > i; n--)
+      kfree(mem[n]);
+    return i > 0;
+}
 
+//record p as the owner of the frame that holds its page at vaddr
+static void
+own_frame(struct proc *p, void *vaddr){
+  pte_t *pte = walkpgdir(p->pgdir,vaddr,0);
+
+  if(pte && (*pte & PTE_P) && PTE_ADDR(*pte) != V2P(zero_page))
+    set_frame_owner(PTE_ADDR(*pte),p,vaddr);
 }
 
-//Dequeue a page
-struct page dequeue(struct proc *pr) {
-  
-    struct p_meta *meta=&(pr->paging_meta);
-    struct page toReturn = meta->pq.pages[0];
-
-    meta->pq.pages[0].exists = 0;
-    meta->pq.pages[0].vaddr  = 0;
-    meta->pq.pages[0].age    = 0;
-    meta->pq.pages[0].age2   = 0;
-    meta->pq.pages[0].in_back= 0;
-    int i;
-    for (i = 0; i < MAX_TOTAL_PAGES; i++) {    //CHANGED to pq.lastIndex from MAX_TOTAL_PAGES
-        if (i == MAX_TOTAL_PAGES - 1){
-            meta->pq.pages[i].exists = 0;
-            meta->pq.pages[i].vaddr  = 0;
-            meta->pq.pages[i].age    = 0;
-            meta->pq.pages[i].age2   = 0;
-            meta->pq.pages[i].in_back= 0;
-        }
-        else
-            meta->pq.pages[i] = meta->pq.pages[i + 1];
+//unmap the resident page at vaddr (entry pte), giving it swap slot #slot.
+//the slot is written into the address bits of the (now non present) entry.
+//returns the page's frame, still holding its contents.
+static char*
+unmap_page(struct proc *p, void *vaddr, pte_t *pte, int slot){
+  char *mem = (char*)P2V(PTE_ADDR(*pte));
+
+  ra_account(find_page(p,vaddr),*pte,1);
+  trace(PGEV_EVICT,p,(uint)vaddr);
+  *pte = SLOT_PTE(slot) | (PTE_FLAGS(*pte) & ~PTE_P) | PTE_PG;
+  page_out_meta(p,vaddr);                             //add to meta-data of the process
+  tlb_flush_page(p->pgdir,vaddr);                     //refresh the Table Lookaside Buffer
+  return mem;
+}
+
+//give back the swap slots p keeps for its clean resident pages (see out_slot).
+//returns their number.
+static int
+drop_swap_cache(struct proc *p){
+  struct p_meta *meta = &p->paging_meta;
+  struct page *pg;
+  int i, j, k, n = 0;
+
+  for(i = 0; i < PMETA_NDIR; i++)
+    if(meta->dir[i])
+      for(j = 0; j < NPDENTRIES; j++)
+        if(meta->dir[i][j])
+          for(k = 0; k < PMETA_LEAF; k++){
+            pg = &meta->dir[i][j][k];
+            if(pg->exists && pg->slot >= 0){
+              swapfree(pg->slot);
+              pg->slot = -1;
+              n++;
+            }
+          }
+  return n;
+}
+
+//the slot for the resident page pg of p (entry pte), and in *write whether
+//the page must be written there.  a page not written since it was paged in
+//goes back to the slot swap still holds it in, a page of only zeros to
+//ZERO_SLOT, any other page to a new swap slot.
+//returns -1 if the swap space is full.
+static int
+out_slot(struct proc *p, struct page *pg, pte_t *pte, int *write){
+  uint *w = (uint*)P2V(PTE_ADDR(*pte));
+  int i, slot;
+
+  *write = 0;
+  if(pg && pg->slot >= 0){
+    slot = pg->slot;
+    pg->slot = -1;
+    if(!(*pte & PTE_D)){
+      clean_outs++;
+      return slot;
     }
-    meta->pq.lastIndex--;
-    return toReturn;
+    swapfree(slot);                                   //the copy in swap is stale
+  }
+  if(w != (uint*)zero_page)
+    for(i = 0; i < PGSIZE/sizeof(uint); i++)
+      if(w[i] != 0){
+        *write = 1;
+        if((slot = swapalloc()) < 0 && drop_swap_cache(p) > 0)
+          slot = swapalloc();
+        return slot;
+      }
+  zero_outs++;
+  return ZERO_SLOT;
 }
 
+//free an unmapped frame, first writing it to swap slot #slot if asked to
+static void
+write_out(struct proc *p, char *mem, int slot, int write){
+  if(write && swapwrite(slot,mem) != 0)               //write the page to the swap space
+    panic("page_out: write");
+  kfree(mem);                                         //free the PHYSICAL memory of the page
+  p->pgc.pages_out++;
+  if(write)
+    p->pgc.swap_written += PGSIZE;
+}
 
+//put the victim select_page_to_back chose back on the queue (SCFIFO and
+//AQ take it off), when it can't be paged out after all
+static void
+unselect(struct proc *p, void *vaddr){
+  struct page *pg = find_page(p,vaddr);
 
+  if(pg && pg->qslot < 0 && !pg->pinned && !pg->held)
+    enqueue(p,pg);                          //the queue exists, it can't fail
+}
 
-//return 1 if the flag FLAG of page 'vaddr' is SET.
+//page out a page with the adderss vaddr.
+//returns 0 if the swap space is full.
 int
-isFlagged(struct proc *p,void* vaddr ,uint FLAG){
-   pte_t * pte=walkpgdir(p->pgdir,vaddr, 0);
-    if((FLAG & *pte) > 0)
+pageOut(struct proc *p,void* vaddr){
+  pte_t *pte;
+  int slot, write;
+
+  if((pte = walkpgdir(p->pgdir,vaddr,0)) == 0 || !(*pte & PTE_P))
+    panic("page_out: not present");
+  //another CPU may have taken the last slot since make_room looked
+  if((slot = out_slot(p,find_page(p,vaddr),pte,&write)) < 0){
+    unselect(p,vaddr);
+    return 0;
+  }
+  write_out(p,unmap_page(p,vaddr,pte,slot),slot,write);
+  return 1;
+}
+
+#ifdef GLOBAL
+// Global replacement: one clock hand sweeps the core map (see kalloc.c) and
+// takes the first frame whose page was not accessed since the hand last
+// passed it, no matter which process owns it.  Only the running process and
+// processes that are off the CPUs can lose pages, and never the pinned ones
+// or those held for a system call (see prefault); a victim is kept off the
+// CPUs (pgtrylock) until its page is unmapped.
+static uint clock_hand;
+
+//try to page out the page in frame #i. returns 1 if it was paged out.
+static int
+clock_evict(struct proc *p, uint i){
+  struct proc *owner;
+  struct page *pg;
+  void *vaddr;
+  pte_t *pte;
+  char *mem = 0;
+  int slot, write;
+
+  if((owner = frame_owner(i,&vaddr)) == 0)
+    return 0;
+  if(owner != p && !pgtrylock(owner))
+    return 0;
+  slot = -1;
+  pte = walkpgdir(owner->pgdir,vaddr,0);
+  //the core map is only a hint - make sure the frame is still mapped there
+  if(pte && (*pte & PTE_P) && PTE_ADDR(*pte) == (i << PGSHIFT) &&
+     (pg = find_page(owner,vaddr)) && !pg->in_back && !pg->pinned && !pg->held){
+    if((*pte & PTE_A) && !seq_passed(owner,pg)){
+      ra_account(pg,*pte,0);
+      *pte &= ~PTE_A;                 //second chance, unless a stream moved past it
+      tlb_flush_page(owner->pgdir,vaddr);
+    }
+    else if(krefcount(i << PGSHIFT) == 1 && (slot = out_slot(owner,pg,pte,&write)) >= 0)
+      mem = unmap_page(owner,vaddr,pte,slot);
+  }
+  if(owner != p)
+    pgthaw(owner);                    //unmapped - the owner may run again
+  if(slot >= 0)
+    write_out(owner,mem,slot,write);
+  if(owner != p)
+    pgunlock(owner);
+  return slot >= 0;
+}
+
+//page out the coldest page in the system. returns 0 if none could be taken.
+static int
+global_evict(struct proc *p){
+  uint i, n = PHYSTOP/PGSIZE;
+
+  //two sweeps: the first one may only clear accessed bits
+  p->pgc.scans++;
+  for(i = 0; i < 2*n; i++){
+    uint frame = clock_hand;
+    clock_hand = (clock_hand + 1) % n;
+    p->pgc.scanned++;
+    if(clock_evict(p,frame))
       return 1;
+  }
+  return 0;
+}
+#endif
+
+//1 if a page must be paged out before p gets another frame
+static int
+need_room(struct proc *p){
+#ifdef GLOBAL
+  return num_free() < MIN_FREE_PAGES;
+#else
+  return charged(p) >= ram_quota(p);
+#endif
+}
+
+//page out a victim to make room in RAM.
+//returns 0 if there is no room left in the swap area.
+static int
+make_room(struct proc *p){
+#ifdef GLOBAL
+  //the reserve is only a watermark - dip into it if nothing can be evicted
+  return global_evict(p) || num_free() > 0;
+#else
+  if(swapavail() == 0)
+    drop_swap_cache(p);
+  if(swapavail() == 0)
     return 0;
+  return pageOut(p,select_page_to_back(p));
+#endif
 }
-void
-setPTE_FLAG(struct proc *p, const void* vadd, uint FLAG){
-  //get the entry
-  pte_t * entry=walkpgdir(p->pgdir,vadd, 0);
-  if(entry == 0)
-    panic("setPTE_PG");
-  *entry |= FLAG;   //clear the  flag
+
+// kswapd: a kernel thread that pages out ahead of demand, so that a fault
+// normally only has to read its page in.  It is woken when a process has
+// fewer than PSYC_LOW pages of RAM quota left (GLOBAL: fewer than FREE_LOW
+// free frames), and pages out until PSYC_HIGH are left (FREE_HIGH free).
+// The fault path still makes room itself if kswapd falls behind.
+// A sleeping process may lose its pages, but not the ones held for the
+// system call it sleeps in (see prefault): the kernel may write them
+// holding a spinlock (piperead, consoleread) once it wakes up.
+static struct spinlock kswapd_lock;
+static int kswapd_work;                 //a watermark was crossed
+
+//1 if p (GLOBAL: the system) has less room than the watermark
+static int
+below(struct proc *p, int mark){
+#ifdef GLOBAL
+  return num_free() < mark;
+#else
+  return ram_quota(p) - charged(p) < mark;
+#endif
+}
+
+//wake kswapd if p crossed the low watermark
+static void
+wake_kswapd(struct proc *p){
+#ifdef GLOBAL
+  if(!below(p,FREE_LOW))
+#else
+  if(!below(p,PSYC_LOW))
+#endif
+    return;
+  acquire(&kswapd_lock);
+  kswapd_work = 1;
+  wakeup(&kswapd_work);
+  release(&kswapd_lock);
+}
+
+static void
+kswapd(void){
+#ifndef GLOBAL
+  struct proc *p;
+  void *vaddr;
+  pte_t *pte;
+  char *mem;
+  int i, slot, write;
+#endif
+
+  for(;;){
+    acquire(&kswapd_lock);
+    while(!kswapd_work)
+      sleep(&kswapd_work,&kswapd_lock);
+    kswapd_work = 0;
+    release(&kswapd_lock);
+
+#ifdef GLOBAL
+    while(below(0,FREE_HIGH) && swapavail() > 0 && global_evict(myproc()))
+      ;
+#else
+    for(i = 0; i < NPROC; i++){
+      p = procslot(i);
+      //one page per locking - p may run while its page is written
+      while(is_user_proc(p) && below(p,PSYC_HIGH) && pgtrylock(p)){
+        if(!below(p,PSYC_HIGH) || charged(p) <= p->paging_meta.num_pinned){
+          pgunlock(p);
+          break;
+        }
+        if(swapavail() == 0)
+          drop_swap_cache(p);
+        if(swapavail() == 0){               //the fault path fails instead
+          pgunlock(p);
+          break;
+        }
+        vaddr = select_page_to_back(p);
+        if((pte = walkpgdir(p->pgdir,vaddr,0)) == 0 || !(*pte & PTE_P))
+          panic("kswapd: not present");
+        if((slot = out_slot(p,find_page(p,vaddr),pte,&write)) < 0){
+          unselect(p,vaddr);
+          pgunlock(p);
+          break;
+        }
+        mem = unmap_page(p,vaddr,pte,slot);
+        pgthaw(p);
+        write_out(p,mem,slot,write);
+        pgunlock(p);
+      }
+    }
+#endif
+  }
 }
+
+//allocate the shared zero frame. it is never freed - the extra reference
+//keeps a write to it copy-on-write.
 void
-clearPTE_FLAG(struct proc *p, const void* vadd, uint FLAG){
-  //get the entry
-  pte_t * entry=walkpgdir(p->pgdir,vadd, 0);
-  if(entry == 0)
-    panic("setPTE_PG");
-  *entry &= ~FLAG;   //clear the  flag
-}
-//  get a page from the back, write it into buffer
-//  vaddr - of the page
-//  return 0 on error
-int
-getPageFromBack(struct proc* p, const void* vaddr, char* buffer){
-  struct page* pages=p->paging_meta.pages;
+zeroinit(void){
+  if((zero_page = kalloc()) == 0)
+    panic("zeroinit");
+  memset(zero_page,0,PGSIZE);
+  set_frame_merged(V2P(zero_page));
+}
+
+#if !defined(GLOBAL) || defined(KSM)
+//sleep for n ticks (the periodic daemons)
+static void
+sleep_ticks(uint n){
+  uint t0;
+
+  acquire(&tickslock);
+  t0 = ticks;
+  while(ticks - t0 < n)
+    sleep(&ticks,&tickslock);
+  release(&tickslock);
+}
+#endif
+
+#ifndef GLOBAL
+// Page-fault frequency (PFF): at the end of every PFF_WINDOW ticks of p's
+// run time, p's RAM allowance grows by PFF_STEP pages if p took more than
+// PFF_HIGH faults on paged out pages in the window, and shrinks by as much
+// if it took fewer than PFF_LOW.  It only grows while FREE_HIGH frames are
+// free.  kswapd pages out what a shrunk allowance leaves over.
+// The caller holds p's paging lock.
+static void
+pff_update(struct proc *p){
+  struct p_meta *meta = &p->paging_meta;
+  int frames = ram_quota(p);
+
+  if(p->vticks - meta->pff_start < PFF_WINDOW)
+    return;
+  meta->pff_rate = meta->pff_faults;
+  meta->pff_faults = 0;
+  meta->pff_start = p->vticks;
+  if(meta->pff_rate > PFF_HIGH && frames + PFF_STEP <= PFF_MAX && num_free() >= FREE_HIGH)
+    frames += PFF_STEP;
+  else if(meta->pff_rate < PFF_LOW && frames - PFF_STEP >= PFF_MIN)
+    frames -= PFF_STEP;
+  meta->frames = frames;
+}
+
+// ager: a kernel thread that ages the pages of every user process off the
+// CPUs every AGE_INTERVAL ticks, so sleeping processes age too, and the timer
+// interrupt does no paging work.  It also runs the PFF controller.
+static void
+ager(void){
+  struct proc *p;
   int i;
-  for(i=0; i  < MAX_TOTAL_PAGES; i++){
-    if (pages[i].exists && pages[i].vaddr  ==   vaddr && pages[i].in_back){
-      uint offset   = pages[i].offset;
-      if(readFromSwapFile(p,buffer,offset,PGSIZE) < 0)
-        panic("get page error");
-      return 1;
+
+  for(;;){
+    sleep_ticks(AGE_INTERVAL);
+    for(i = 0; i < NPROC; i++){
+      p = procslot(i);
+      if(is_user_proc(p) && pgtrylock(p)){
+        age_process_pages(p);
+        pff_update(p);
+        pgunlock(p);
+        wake_kswapd(p);                 //over a shrunk allowance
+      }
     }
   }
-  return 0;
 }
+#endif
 
-//update page meta-data when going to front
-int 
-page_in_meta(struct proc* p,void* vaddr){
-  //cprintf("paging in meta- %x\n",vaddr);
-   struct p_meta *meta  =   &p->paging_meta;
-   struct page *pages   =   meta->pages;
-   int i;
-   for(i=0; i<MAX_TOTAL_PAGES; i++){
-     if(pages[i].vaddr  ==  vaddr){
-       //cprintf("found paging in meta!!\n");
-       pages[i].in_back =   0;                       //mark as "NOT Backed"
-       meta->offsets[pages[i].offset / PGSIZE] = 0;  //mark offset as free
-       pages[i].age = 0;                             //reset age
-       pages[i].age2= 0xffffffff;
-       enqueue(p,pages[i]);                          //enqueue after paging in .
-       return 1;
-     }
-   }
-   return 0;
-}
-//  Called only after checking that this page is indeed paged out!
-//  And only when there's less than MAX_PSYC pages in memory.
-int
-pageIn(struct proc *p, void* vaddr){
-    //cprintf("paging in: %x\n",vaddr);
-    char* paddr;    //will contain Physical address that the page would be written to.
-    paddr = kalloc();                           //allocate physical page
-    if(mappages(p->pgdir,vaddr,PGSIZE,V2P(paddr), PTE_U|PTE_W)!=0)    //map the vaddr to the newly allocated Paddr
-      panic("pagein-mappages");
+void
+kswapdinit(void){
+  initlock(&kswapd_lock,"kswapd");
+  kthread("kswapd",kswapd);
+#ifndef GLOBAL
+  kthread("ager",ager);
+#endif
+}
 
+#ifdef KSM
+// ksmd: same-page merging.  A kernel thread scans the resident pages of the
+// user processes, KSM_BATCH pages every KSM_SLEEP ticks, and maps pages with
+// the same contents to one merged frame, read-only everywhere (a write is
+// copied, see cow_fault).  A page is merged only if its checksum did not
+// change since the previous scan, so pages that are being written are left
+// alone.  Candidate frames are remembered by checksum in ksm_table.
+struct ksm_ent {
+  uint        sum;                //checksum of the frame's contents
+  uint        pa;                 //the frame, 0 if the entry is empty
+  struct proc *owner;             //the process that maps it, 0 if it is merged
+  void        *vaddr;             //where owner maps it
+};
+static struct ksm_ent ksm_table[KSM_NHASH];
+static int ksm_proc;                    //scan position: process slot
+static uint ksm_va;                     //and virtual address in it
+uint ksm_scanned, ksm_merged;
+
+//checksum of the page at mem
+static uint
+ksm_sum(uint *mem){
+  uint sum = 0;
+  int i;
 
+  for(i = 0; i < PGSIZE/sizeof(uint); i++)
+    sum = sum*31 + mem[i];
+  return sum;
+}
 
-    if(!getPageFromBack(p,vaddr,vaddr))             //write the page into memory (vaddr is already mapped to paddr)
-      return 0;
-    clearPTE_FLAG(p,vaddr,PTE_PG);             //clear the PAGED OUT flag
-    setPTE_FLAG(p,vaddr,PTE_P);                 //set the PRESENT flag
-    if(!page_in_meta(p,vaddr))                      //remove meta data from the process meta-data struct 
-      return 0;
-    return 1;   
+//map the merged frame pa, which holds the same contents, in place of the
+//frame of p's page in entry pte.  returns 0 if pa is no longer merged.
+static int
+ksm_map(struct proc *p, void *vaddr, pte_t *pte, uint pa){
+  char *old = (char*)P2V(PTE_ADDR(*pte));
+
+  if(!kref_merged(pa))
+    return 0;
+  if(*pte & PTE_W)
+    *pte = (*pte & ~PTE_W) | PTE_COW;
+  *pte = pa | PTE_FLAGS(*pte);
+  tlb_flush_page(p->pgdir,vaddr);
+  kfree(old);                           //drop our reference
+  ksm_merged++;
+  return 1;
 }
 
-//returns 1 if the page is PAGED OUT (not present AND marked as paged out.)
-int
-isPagedOut(struct proc *p,  void* vaddr){
-  void * rounded=(void *)PGROUNDDOWN((uint)vaddr);
-  if( !isFlagged(p,vaddr,PTE_P)  &&  isFlagged(p,rounded,PTE_PG))
-    return 1;
-  return 0;
+//merge the page at vaddr (entry pte) of p, the process being scanned, with a
+//frame of table entry e that has the same checksum.  a frame that is not
+//merged yet becomes merged, once its owner can't write it any more.
+static int
+ksm_merge(struct proc *p, void *vaddr, pte_t *pte, struct ksm_ent *e){
+  struct proc *owner = e->owner;
+  struct page *epg;
+  pte_t *epte;
+  int ok = 0;
+
+  if(owner == 0)
+    return memcmp(P2V(e->pa),P2V(PTE_ADDR(*pte)),PGSIZE) == 0 && ksm_map(p,vaddr,pte,e->pa);
+  if(owner != p && !pgtrylock(owner))
+    return 0;
+  epte = walkpgdir(owner->pgdir,e->vaddr,0);
+  epg = find_page(owner,e->vaddr);
+  //a held or pinned page must stay writable (see hold)
+  if(epte && (*epte & (PTE_P|PTE_U)) == (PTE_P|PTE_U) && PTE_ADDR(*epte) == e->pa &&
+     (epg == 0 || (!epg->held && !epg->pinned)) &&
+     memcmp(P2V(e->pa),P2V(PTE_ADDR(*pte)),PGSIZE) == 0){
+    if(*epte & PTE_W){
+      *epte = (*epte & ~PTE_W) | PTE_COW;
+      tlb_flush_page(owner->pgdir,e->vaddr);
+    }
+    set_frame_merged(e->pa);
+    e->owner = 0;
+    ok = ksm_map(p,vaddr,pte,e->pa);
+  }
+  if(owner != p)
+    pgunlock(owner);
+  return ok;
 }
-//get the next free offset in the Back file
-//return PGFILE_FULL_ERR if none found (file is full  - TODO: Possible?!)
-uint
-getFreePageOffset(struct proc *p){
-  struct p_meta *meta=&p->paging_meta;
-  int i;
 
-  for(i=0; i< MAX_TOTAL_PAGES; i++){
-    if(meta -> offsets[i] == 1) //if taken, continue..
-      continue;
-    return PGSIZE * i ;
-  }
-  return PGFILE_FULL_ERR ;
-}
-
-//adds a page to the meta data of the Process (when a page is added to the back)
-//page needs to already exist in the list.
-int 
-page_out_meta(struct proc *p,void* vaddr,uint offset){
-   struct p_meta *meta  =   &p->paging_meta;
-   struct page *pages   =   meta->pages;
-   int i;
-   for(i=0; i<MAX_TOTAL_PAGES; i++){
-     //cprintf("index: %d, vaddr: %x, exists: %d, in back: %d\n",i,pages[i].vaddr,pages[i].exists,pages[i].in_back);
-     if(pages[i].exists  && pages[i].vaddr  ==  vaddr){
-       //cprintf("found paging out!: %x,  %x\n",vaddr,pages[i].vaddr);
-       pages[i].in_back =   1;              //mark as "Backed"
-       pages[i].offset  =   offset;         //store the offset of the page
-       meta->offsets[offset / PGSIZE] = 1;  //mark offset as taken
-       //cprintf("marking i: %d as taken\n",offset/PGSIZE);
-       return 1;
-     }
-   }
-   return 0;
-}
-
-// adds a page (with address vadd) to the back (the file)
-int
-addPageToBack(struct proc *p, void* vaddr){
-    int free_offset=getFreePageOffset(p);
+//scan the resident page at vaddr (entry pte) of p
+static void
+ksm_page(struct proc *p, void *vaddr, pte_t *pte){
+  uint pa = PTE_ADDR(*pte);
+  struct page *pg = find_page(p,vaddr);
+  struct ksm_ent *e;
+  uint sum;
+
+  ksm_scanned++;
+  if(pg == 0 || pg->held || pg->pinned || frame_merged(pa))
+    return;                             //held and pinned pages stay writable
+  sum = ksm_sum((uint*)P2V(pa));
+  if(sum != pg->sum){                   //changed since the last scan
+    pg->sum = sum;
+    return;
+  }
+  if(sum == 0 && memcmp(P2V(pa),zero_page,PGSIZE) == 0 && ksm_map(p,vaddr,pte,V2P(zero_page)))
+    return;
+  e = &ksm_table[sum % KSM_NHASH];
+  if(e->pa != 0 && e->pa != pa && e->sum == sum && ksm_merge(p,vaddr,pte,e))
+    return;
+  if(e->owner == 0 && e->pa != 0 && e->sum == sum && frame_merged(e->pa))
+    return;                             //keep the merged frame
+  e->sum = sum;
+  e->pa = pa;
+  e->owner = p;
+  e->vaddr = vaddr;
+}
 
-    if(free_offset == PGFILE_FULL_ERR)
-      return 0;
-   
-    writeToSwapFile(p,(char *)PTE_ADDR(vaddr),free_offset,PGSIZE);    //  write the page to the swap file
-    page_out_meta(p,(char *)PTE_ADDR(vaddr),free_offset);                       //  add to meta-data of the process
-   
-    return 1;
+//scan up to n pages of p from ksm_va on. returns the number scanned,
+//with ksm_va set to 0 once p is done.
+static int
+ksm_scan(struct proc *p, int n){
+  pte_t *pte;
+  int done = 0;
+
+  for(; ksm_va < p->sz && done < n; ksm_va += PGSIZE){
+    pte = walkpgdir(p->pgdir,(void*)ksm_va,0);
+    if(pte && (*pte & (PTE_P|PTE_U)) == (PTE_P|PTE_U)){
+      ksm_page(p,(void*)ksm_va,pte);
+      done++;
+    }
+  }
+  if(ksm_va >= p->sz)
+    ksm_va = 0;
+  return done;
 }
 
-//page out a page with the adderss vaddr
-int
-pageOut(struct proc *p,void* vaddr){
-  //cprintf("paging out - %x\n",vaddr);
-  char* to_free;
-   //write page to the Back file.
-  if(addPageToBack(p,vaddr)){
-    pte_t *pte=walkpgdir(p->pgdir,vaddr,0);
-
-    to_free=(char*)P2V(PTE_ADDR(*pte));   
-    kfree(to_free);                                   //free the PHYSICAL memory of the page
-    clearPTE_FLAG(p,vaddr,PTE_P);                     //clear the Present flag from the page table entry
-    setPTE_FLAG(p,vaddr,PTE_PG);                      //set the PAGED-OUT flag
-    
-    pte=walkpgdir(p->pgdir,vaddr,0);
-    
-    lcr3(V2P(p->pgdir));                              //refresh the Table Lookaside Buffer   
-    p->num_pageouts++;         
-    return 1;
+static void
+ksmd(void){
+  struct proc *p;
+  int i, n;
+
+  for(;;){
+    sleep_ticks(KSM_SLEEP);
+
+    for(i = 0, n = KSM_BATCH; i < NPROC && n > 0; i++){
+      p = procslot(ksm_proc);
+      if(is_user_proc(p) && pgtrylock(p)){
+        n -= ksm_scan(p,n);
+        pgunlock(p);
+        if(ksm_va != 0)                 //out of budget in the middle of p
+          break;
+      }
+      ksm_va = 0;
+      ksm_proc = (ksm_proc + 1) % NPROC;
+    }
   }
-  else
-    panic("page_out");
-  return 0;   //error adding page to Back
 }
 
+void
+ksminit(void){
+  kthread("ksmd",ksmd);
+}
+#endif
+
 //returns the number of paged out Pages
 int
 numOfPagedOut(struct proc *p){
-  struct page* pages=p->paging_meta.pages;
-  int i;
-  int counter = 0;
-  for(i=0; i  <MAX_TOTAL_PAGES; i++){
-    if(pages[i].exists  == 0)
-      continue;  
-    if(pages[i].in_back ==  1)
-      counter ++;
-  }
-  return counter;  
+  return p->paging_meta.num_in_back;
 }
 //Number of pages in RAM
 int
 numOfPagedIn(struct proc *p){
-  struct page* pages=p->paging_meta.pages;
-  int i;
-  int counter = 0;
-  for(i=0; i  <MAX_TOTAL_PAGES; i++){
-    if(pages[i].exists  == 0)
-      continue;  
-    if(pages[i].in_back ==  0 && pages[i].exists == 1)
-      counter ++;
-  }
-  return counter;  
+  return p->paging_meta.num_in_ram;
 }
-//page in a certain page - page-out another if needed
+//page in a certain page - page-out another if needed.
+//a single walk of the page table finds both the entry and its swap slot.
+//returns 0 if vaddr is not paged out, or it can't be paged in.
 int
 safe_page_in(struct proc* p,void *vaddr){
-  if(numOfPagedIn(p) == MAX_PSYC_PAGES){
-    //cprintf("ram full, paging out first-\n");
-    pageOut(p,select_page_to_back(p));
+  void *rounded=(void *)PGROUNDDOWN((uint)vaddr);
+  pte_t *pte=walkpgdir(p->pgdir,rounded,0);
+
+  if(pte == 0 || (*pte & PTE_P) || !(*pte & PTE_PG))
+    return 0;
+  policy_fault(p,rounded);
+  //the slot of the faulting page is released only after paging in, so
+  //a full swap area can't take the victim.
+  if(need_room(p) && !make_room(p)){
+    cprintf("pid %d: out of swap space\n",p->pid);
+    return 0;
   }
 
-  return pageIn(p,(void *)PGROUNDDOWN((uint)vaddr));
+  return swap_in(p,rounded,pte);
 }
-//copy the parent's swapfile to the child.
-//copy only if parent is not the shell or init.
+
+//copy the paging meta-data of the parent, with its own radix tree and queue.
+//returns 0 if out of memory, leaving nothing allocated.
 int
-copy_parent_swapfile(struct proc *child, struct proc *parent){
-
-
-    //cprintf("copy_parent_swapfile - checking pte flags\n");
-    //pte_t *e=walkpgdir(child->pgdir,(void*)4000,0);
-    //cprintf("child flags for address 4000: %x\n",PTE_FLAGS(*e));
-   // e=walkpgdir(parent->pgdir,(void*)4000,0);
-   // cprintf("parent flags for address 4000: %x\n",PTE_FLAGS(*e));
-    int chunk=  PGSIZE/2;   //limit ? 
-    int bytes_read;
-    char buff [PGSIZE/2]="";
-    int offset=0;
-    //cprintf("copying swapfile from %d to %d     (not really copying)\n",parent->pid,child->pid);
-    while((bytes_read=readFromSwapFile(parent,buff,offset,chunk))>0){//read chunk from parent
-      writeToSwapFile(child,buff,offset,chunk);                      //write chunk to child
-      offset+=bytes_read;                                            //next offset
+copy_paging_meta(struct proc *child, struct proc *parent){
+  struct p_meta *from=&parent->paging_meta, *to=&child->paging_meta;
+  struct page *pg;
+  int i, j, k;
+
+  memmove(to,from,sizeof(*to));
+  memset(to->dir,0,sizeof(to->dir));
+  to->pq.slots=0;
+  for(i=0; i<NHEAP; i++){                 //built again on first use
+    to->heap[i].slots=0;
+    to->heap[i].valid=0;
+  }
+  to->num_pinned=0;
+  to->num_held=0;
+  to->held_va=to->held_end=0;
+  if(from->pq.slots){
+    if((to->pq.slots = (int*)kalloc()) == 0)
+      goto bad;
+    memmove(to->pq.slots,from->pq.slots,PGSIZE);
+  }
+  for(i=0; i<PMETA_NDIR; i++){
+    if(from->dir[i] == 0)
+      continue;
+    if((to->dir[i] = (struct page**)kalloc()) == 0)
+      goto bad;
+    memset(to->dir[i],0,PGSIZE);
+    for(j=0; j<NPDENTRIES; j++){
+      if(from->dir[i][j] == 0)
+        continue;
+      if((to->dir[i][j] = (struct page*)kalloc()) == 0)
+        goto bad;
+      memmove(to->dir[i][j],from->dir[i][j],PGSIZE);
+      for(k=0; k<PMETA_LEAF; k++){          //the child's copies are its own frames
+        pg=&to->dir[i][j][k];
+        if(pg->exists && !pg->in_back)
+          own_frame(child,pg->vaddr);
+        if(pg->exists && pg->slot >= 0)     //and shares the clean copies in swap
+          swapdup(pg->slot);
+        if(pg->pinned || pg->held){         //mlock is not inherited
+          pg->pinned=0;
+          pg->held=0;
+          if(!enqueue(child,pg))
+            goto bad;
+        }
+      }
     }
-    //copy all the meta data from the parent
-    memmove(&child->paging_meta,&parent->paging_meta,sizeof(struct p_meta));
-    
-  
+  }
   return 1;
+
+bad:
+  reset_paging_meta(child);
+  return 0;
 }
 
 //return number of allocated pages for this process
 int
 get_allocated_pages(struct proc *p){
-  struct page *pages=p->paging_meta.pages;
-  int i;
-  int counter = 0;
-  for(i=0; i<MAX_TOTAL_PAGES; i++){
-    if(pages[i].exists){
-      counter++;
-    }
-  }
-  return counter;
-}
-int
-clearPTE_P(struct proc *p, const void* vadd){
-  //get the entry
-  pte_t * entry=walkpgdir(p->pgdir,vadd, 0);
-  if(entry == 0)
-    panic("clearPTE_P");
-  *entry &= ~PTE_P;   //clear the P flag
-  return 1;
-}
-int
-setPTE_PG(struct proc *p, const void* vadd){
-  //get the entry
-  pte_t * entry=walkpgdir(p->pgdir,vadd, 0);
-  if(entry == 0)
-    panic("setPTE_PG");
-  *entry |= PTE_P;   //clear the P flag
-  return 1;
-}
-// counter number of 1's in a number
-uint 
-count_set_bits(uint number){
-  uint counter  =   0;
-  int i;
-  for(i=0; i<32; i++){
-    if((number | 1) > 0)
-      counter ++;
-    number = number / 2;
-  }
-  return counter;
+  return p->paging_meta.num_in_ram + p->paging_meta.num_in_back;
 }
 // Adds a TOTALLY new page to the process's list.
+// returns 0 if out of memory for the meta-data.
 int
 add_new_page(struct proc *p, void* vaddr){
-  //cprintf("proc: %d adding page: %x\n",p->pid,vaddr);
-  struct p_meta *meta = &p->paging_meta;
-  struct page *pages= meta->pages;
+  struct page *pg;
 
   //cprintf("pid: %d adding page: %x\n",p->pid,vaddr);
-  int i;
-  struct page toAdd={.exists = 1, .vaddr = vaddr, .in_back = 0, .age = 0, .age2 = 0xffffffff};
-  for(i=0; i<MAX_TOTAL_PAGES; i++){
-    if(pages[i].exists && pages[i].vaddr == vaddr){
-      panic("add_new_page vaddr exists");
-    }
-    if(pages[i].exists)
+  if((pg = page_lookup(p,vaddr,1)) == 0)
+    return 0;
+  if(pg->exists)
+    panic("add_new_page vaddr exists");
+  if(!page_new_meta(p,pg,vaddr))
+    return 0;
+  own_frame(p,vaddr);
+  return 1;
+}
+
+//start tracking the pages of a fresh image (exec) that are already there -
+//the rest are tracked as they are faulted in.  the stack guard (no PTE_U)
+//is never tracked, so it's never paged out.
+//pages beyond the RAM quota are paged out. returns 0 on failure.
+int
+add_image_pages(struct proc *p){
+  pte_t *pte;
+  uint a;
+
+  for(a = 0; a < p->sz; a += PGSIZE){
+    if((pte = walkpgdir(p->pgdir,(void *)a,0)) == 0 ||
+       (*pte & (PTE_P|PTE_U)) != (PTE_P|PTE_U))
       continue;
-   
-    pages[i]  = toAdd;
-    enqueue(p,toAdd);
-    //cprintf("pid: %d ---added--- page: %x. now in ram %d\n",p->pid,vaddr,numOfPagedIn(p));
-    return 1;
+    if(need_room(p) && !make_room(p))
+      return 0;
+    if(!add_new_page(p,(void *)a))
+      return 0;
   }
-  return 0;
+  return 1;
 }
 
 //Aging
+//harvest the accessed bits of proc's pages in one pass over its page table
+//pages, shifting them into the ages.  the caller holds proc's paging lock.
 void
 age_process_pages(struct proc* proc){
-  struct page * pa_arr=proc->paging_meta.pages;
-  int i;
-  //for every page
-  for(i=0; i<MAX_TOTAL_PAGES; i++){
-    if(!pa_arr[i].exists  || pa_arr[i].in_back){     
+  struct tlb_batch b = { proc->pgdir, 0 };
+  struct page *pg;
+  pte_t *pt;
+  uint va, acc;
+  int i, j;
+
+  for(i = 0; i < PDX(KERNBASE) && PGADDR(i,0,0) < proc->sz; i++){
+    if(!(proc->pgdir[i] & PTE_P))
       continue;
-    }
-    
-    pte_t *e= walkpgdir(proc->pgdir,pa_arr[i].vaddr,0);
-
-    if((*e & PTE_A) > 0){                     // if accessed
-      
-     
-      *e &=~PTE_A;                            // clear Accessed bit
-      pa_arr[i].age=pa_arr[i].age >> 1;       //shift right
-      pa_arr[i].age=pa_arr[i].age | MSB;     //set MSB 
-      //for LAPA
-      pa_arr[i].age2=pa_arr[i].age2 >> 1;     //shift right
-      pa_arr[i].age2=pa_arr[i].age2 | MSB;   //set MSB 
-      
-    }
-    else{                             //if not visited 
-      pa_arr[i].age=pa_arr[i].age >> 1;       //just shift right
-      pa_arr[i].age2=pa_arr[i].age2 >> 1;       //just shift right
-    }
-    //cprintf("A - entry      %x\n",pa_arr[i].age);
-  }
-
-#ifdef AQ
-  struct page_queue *pq=&proc->paging_meta.pq;   //access the actuall Page Queue
-  struct page *pa= pq->pages;                 //access the Queue's array.
-  int j;
-
-  //start from the second place from last.
-  for(j = pq->lastIndex - 1; j>=0; j--){
-    pte_t *entry_j = walkpgdir(proc->pgdir,pa[j].vaddr,0);
-    pte_t *entry_prec_j = walkpgdir(proc->pgdir,pa[j+1].vaddr,0);
-    //if the i'th page was accessed, and the i-1 not, switch them.
-    if((*entry_j & PTE_A) > 0 && (*entry_prec_j & PTE_A)<=0){
-      struct page temp=pa[j];
-      pa[j] = pa[j+1];
-      pa[j+1]=temp;
-    }
-  }
-  //Clean up Accessed bits
-  for(j = pq->lastIndex - 1; j>=0; j--){
-    pte_t *entry=walkpgdir(proc->pgdir,pa[j].vaddr,0);
-    *entry &=~PTE_A;                   // clear Accessed bit
-  }
-#endif
-}
-// Returns a Virtual Address of a page to be replaced in the RAM, according to replacement algorithms.
-void*
-select_page_to_back(struct proc *p){
-  //implement algorithms
-    
-    #ifdef NFUA
-    struct page  min_page={.exists = 0, .vaddr=(void *)0, .in_back=0,.offset=0, .age=0,.age2=0};   
-    int i = 0;
-    struct page * pa  =   (&(p->paging_meta))->pages;
-    //first loop  - get the first page that exists and is NOT in the back, and is legal to swap out
-    for(i = 0; i<MAX_TOTAL_PAGES; i++){
-      if(pa[i].exists && !pa[i].in_back){
-          min_page=pa[i];
-          break;
-      }
-    }
-    //Possible bug?
-    for(; i<MAX_TOTAL_PAGES; i++){
-      if(!pa[i].exists || pa[i].in_back)  //if does not exist, already in back OR not legal to swap out, skip.
+    pt = (pte_t*)P2V(PTE_ADDR(proc->pgdir[i]));
+    for(j = 0; j < NPTENTRIES && (va = PGADDR(i,j,0)) < proc->sz; j++){
+      if((pt[j] & (PTE_P|PTE_U)) != (PTE_P|PTE_U) ||
+         (pg = find_page(proc,(void*)va)) == 0 || pg->in_back)
         continue;
-      if(pa[i].age < min_page.age){
-        min_page=pa[i];
+      acc = pt[j] & PTE_A;
+      if(acc){                                  // if accessed
+        ra_account(pg,pt[j],0);
+        pt[j] &= ~PTE_A;                        // clear Accessed bit
+        tlb_batch_add(&b,va,0);                 // so the next access sets it again
       }
+      age_page(proc,pg,acc != 0);
     }
-    //return this page's vaddr
-
-    dequeue(p);  //without returning (queue not needed)
-
-
-    return min_page.vaddr;
-    #endif
+  }
+  tlb_batch_flush(&b);
+  policy_aged(proc);
+}
 
+//set the advice of p's pages in [va, end) - RANDOM, SEQUENTIAL or NORMAL.
+//returns -1 if out of memory for the meta-data.
+static int
+advise_pages(struct proc *p, uint va, uint end, int advice){
+  struct page *pg;
 
-    #ifdef LAPA
-    int    min_count;         //min num of set bits
-    struct page  min_page={.exists = 0, .vaddr=(void *)0, .in_back=0,.offset=0, .age=0,.age2=0};   
-    int i = 0;
-    struct page * pa  =   (&(p->paging_meta))->pages;
-    //first loop  - get the first page that exists and is NOT in the back, and legal to swap out
-    for(i = 0; i<MAX_TOTAL_PAGES; i++){
-      if(pa[i].exists && !pa[i].in_back){
-          min_count=count_set_bits(pa[i].age2);
-          min_page=pa[i];
-          break;
-      }
-    }
-    //Possible bug?
-    for(; i<MAX_TOTAL_PAGES; i++){
-      if(!pa[i].exists || pa[i].in_back || pa[i].vaddr  ==  min_page.vaddr)  //as above
-        continue;
-      int curr_count  = count_set_bits(pa[i].age2);
-      if(curr_count < min_count){
-        min_count=curr_count;
-        min_page=pa[i];
-      }
-      else if( curr_count == min_count){
-        if(pa[i].age2 < min_page.age2){
-          min_count=count_set_bits(pa[i].age2);
-          min_page=pa[i];
-        }
-      }
-    }
-    dequeue(p);  //without returning (queue not needed)
+  for(; va < end; va += PGSIZE){
+    if((pg = page_lookup(p,(void*)va,1)) == 0)
+      return -1;
+    pg->advice = advice == MADV_NORMAL ? 0 : advice;
+  }
+  if(advice == MADV_SEQUENTIAL)
+    p->paging_meta.seq_advice = 1;
+  return 0;
+}
 
-    //return this page's vaddr
-    return min_page.vaddr;
-    #endif
-    #ifdef SCFIFO
-    struct page current;
-    while(1){
-      current = dequeue(p);
-      pte_t *e= walkpgdir(p->pgdir,current.vaddr,0);  //get the PTE
-      if((*e & PTE_A) > 0){              // if accessed 
-          *e &=~PTE_A;                   // clear Accessed bit
-          enqueue(p,current);            // give second chance
-      }
-      else{                              //if not accessed
-        return current.vaddr;
-      }
-    }
-    #endif
+//page in p's paged out pages in [va, end), as many as fit in its RAM.
+static void
+willneed(struct proc *p, uint va, uint end){
+  int n = 0;
 
-    #ifdef AQ
-      struct page toReturn;
-      toReturn  = dequeue(p);
-      return toReturn.vaddr;
-    
-    #endif
-  
-  #ifdef NONE
-  return (void*) 1;   //delete
-  #endif
+  for(; va < end && n < ram_quota(p); va += PGSIZE)
+    if(safe_page_in(p,(void*)va))
+      n++;
 }
+
+//free all paging meta-data of the process
 void
 reset_paging_meta(struct proc* pr){
-   memset(&pr->paging_meta,0,sizeof(struct p_meta));
+  struct p_meta *meta=&pr->paging_meta;
+  int i, j;
+
+  drop_swap_cache(pr);
+  for(i=0; i<PMETA_NDIR; i++){
+    if(meta->dir[i] == 0)
+      continue;
+    for(j=0; j<NPDENTRIES; j++)
+      if(meta->dir[i][j])
+        kfree((char*)meta->dir[i][j]);
+    kfree((char*)meta->dir[i]);
+  }
+  if(meta->pq.slots)
+    kfree((char*)meta->pq.slots);
+  for(i=0; i<NHEAP; i++)
+    if(meta->heap[i].slots)
+      kfree((char*)meta->heap[i].slots);
+  memset(meta,0,sizeof(struct p_meta));
 }
 #endif
 
+//fill in the system-wide counters of st (see getpgstat)
+void
+pgstat_sys(struct pgstat *st){
+  st->free_pages  = num_free();
+#ifndef NONE
+  st->ra_reads    = ra_reads;
+  st->ra_hits     = ra_hits;
+  st->ra_misses   = ra_misses;
+  st->zero_outs   = zero_outs;
+  st->zero_ins    = zero_ins;
+  st->clean_outs  = clean_outs;
+#ifdef KSM
+  st->ksm_scanned = ksm_scanned;
+  st->ksm_merged  = ksm_merged;
+  st->ksm_saved   = merged_savings();
+#endif
+  swapstat(st);
+#endif
+}
+
 //PAGEBREAK!
 // Blank page.
 //PAGEBREAK!